@@ -23,6 +23,9 @@ extern "C" {
 #ifndef ZS_PIPE_T_DEFINED
 typedef struct _zs_pipe_t zs_pipe_t;
 #endif
+#ifndef ZS_RING_T_DEFINED
+typedef struct _zs_ring_t zs_ring_t;
+#endif
 
 //  @interface
 //  Create a new zs_pipe, return the reference if successful, or NULL
@@ -126,11 +129,74 @@ void
 void
     zs_pipe_pull_array (zs_pipe_t *self, zs_pipe_t *source);
 
+//  Pulls up to count values, including marks, off the start of the source
+//  pipe and appends them to the pipe, keeping their order. We use this to
+//  split a pipe into chunks, and to join chunks back together.
+void
+    zs_pipe_pull_count (zs_pipe_t *self, zs_pipe_t *source, size_t count);
+
+//  Return number of values in the pipe, including marks.
+size_t
+    zs_pipe_size (zs_pipe_t *self);
+
 //  Return pipe contents, as string. Caller must free it when done. Values are
 //  separated by spaces. This empties the pipe.
 char *
     zs_pipe_paste (zs_pipe_t *self);
 
+//  Return pipe contents, encoded in binary wire format. Caller must destroy
+//  the chunk when done. This empties the pipe. Each value is a type byte
+//  followed by its data: 'w' + zigzag varint, 'r' + 8-byte IEEE 754 double
+//  in network order, 's' + varint length + string bytes, and '|' for marks.
+zchunk_t *
+    zs_pipe_encode (zs_pipe_t *self);
+
+//  Decode a buffer in binary wire format and append its values to the pipe.
+//  Returns 0 if OK, or -1 if the buffer was malformed, in which case the
+//  pipe is left unchanged.
+int
+    zs_pipe_decode (zs_pipe_t *self, const byte *data, size_t size);
+
+//  Return pipe contents, encoded in binary wire format, as a new frame.
+//  Caller must destroy the frame when done. This empties the pipe.
+zframe_t *
+    zs_pipe_encode_frame (zs_pipe_t *self);
+
+//  Decode a frame in binary wire format and append its values to the pipe.
+//  Returns 0 if OK, or -1 if the frame was malformed.
+int
+    zs_pipe_decode_frame (zs_pipe_t *self, zframe_t *frame);
+
+//  Append pipe contents, encoded in binary wire format, to the message as
+//  a single frame. This empties the pipe.
+void
+    zs_pipe_encode_msg (zs_pipe_t *self, zmsg_t *msg);
+
+//  Decode every frame of the message in order and append the values to the
+//  pipe. Returns 0 if OK, or -1 if any frame was malformed; frames decoded
+//  before the malformed one are kept.
+int
+    zs_pipe_decode_msg (zs_pipe_t *self, zmsg_t *msg);
+
+//  Prepare a ring to carry pipe values, so that values left in the ring are
+//  destroyed with it. Call this once, when connecting the ring, before any
+//  thread sends on it.
+void
+    zs_pipe_prepare_ring (zs_ring_t *ring);
+
+//  Move all values in the pipe, including marks, onto the ring, and end
+//  them as one sentence. Values are handed over without copying, to be
+//  collected by another thread with zs_pipe_recv_ring. Returns 0 if OK, or
+//  -1 if the ring was closed, in which case unsent values stay in the pipe.
+int
+    zs_pipe_send_ring (zs_pipe_t *self, zs_ring_t *ring);
+
+//  Receive one sentence from the ring and append its values to the pipe,
+//  waiting according to the ring's backpressure mode. Returns 0 if OK, or
+//  -1 if the ring was closed and drained, or the process was interrupted.
+int
+    zs_pipe_recv_ring (zs_pipe_t *self, zs_ring_t *ring);
+
 //  Print pipe contents, for debugging, prints nothing if pipe is empty
 void
     zs_pipe_print (zs_pipe_t *self, const char *prefix);
@@ -30,6 +30,14 @@ typedef struct _zs_repl_t zs_repl_t;
 zs_repl_t *
     zs_repl_new (void);
 
+//  Create a new repl engine that shares the functions defined so far in this
+//  one, without copying them. The new engine keeps its own definitions to
+//  itself. This engine must not execute any more input until all its forks
+//  are destroyed, though forks may execute from different threads. Returns
+//  the reference if successful, or NULL if construction failed.
+zs_repl_t *
+    zs_repl_fork (zs_repl_t *self);
+
 //  Destroy the zs_repl and free all memory used by the object
 void
     zs_repl_destroy (zs_repl_t **self_p);
@@ -44,6 +52,52 @@ void
 int
     zs_repl_execute (zs_repl_t *self, const char *input);
 
+//  Execute a file of code, line by line, as if each line was passed to
+//  zs_repl_execute. Where possible the file is memory-mapped, so that the
+//  lexer works directly on the file contents and memory use does not grow
+//  with the file size. If output is not NULL, prints the results of each
+//  completed line to it. Stops at the first syntax error. Returns 0 if OK,
+//  or -1 if the file could not be read, had a syntax error, or ended in
+//  the middle of a statement.
+int
+    zs_repl_execute_file (zs_repl_t *self, const char *filename, FILE *output);
+
+//  Execute code read from a stream, line by line, as if each line was passed
+//  to zs_repl_execute. Reads the stream in large chunks; a line or statement
+//  may span chunks, and memory use depends only on the longest line. If
+//  output is not NULL, prints the results of each completed line to it.
+//  Stops at the first syntax error. Returns 0 if OK, or -1 if the stream
+//  could not be read, had a syntax error, or ended in the middle of a
+//  statement.
+int
+    zs_repl_execute_stream (zs_repl_t *self, FILE *input, FILE *output);
+
+//  Compile a complete statement into a function that you can run many times
+//  with zs_repl_run, without lexing or compiling it again. The function
+//  sees the definitions made before it; later definitions do not change
+//  it. Returns a handle to the function, or 0 if the text had a syntax
+//  error, was not a complete statement, or the repl is in the middle of
+//  a statement.
+size_t
+    zs_repl_compile (zs_repl_t *self, const char *text);
+
+//  Run a function compiled by zs_repl_compile; fetch its output with
+//  zs_repl_results. Returns 0 if OK, or -1 if the function failed.
+int
+    zs_repl_run (zs_repl_t *self, size_t handle);
+
+//  Release a function compiled by zs_repl_compile; the handle is then no
+//  longer valid. Functions are stored as a stack, so the memory is only
+//  reclaimed once every function defined after this one is also released.
+void
+    zs_repl_release (zs_repl_t *self, size_t handle);
+
+//  Return number of the line that zs_repl_execute_file or
+//  zs_repl_execute_stream executed last, counting from 1. After a syntax
+//  error, this is the line with the error.
+size_t
+    zs_repl_line (zs_repl_t *self);
+
 //  Return true if the input formed a complete phrase that was successfully
 //  evaulated. If not, the core expects more input.
 bool
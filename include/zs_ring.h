@@ -0,0 +1,92 @@
+/*  =========================================================================
+    zs_ring - single-producer, single-consumer ring between threads
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZS_RING_H_INCLUDED
+#define ZS_RING_H_INCLUDED
+
+#include <czmq.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Opaque class structure
+#ifndef ZS_RING_T_DEFINED
+typedef struct _zs_ring_t zs_ring_t;
+#endif
+
+//  What a thread does when the ring is full (producer) or empty (consumer)
+typedef enum {
+    //  Sleep until the other side makes progress; this is the default
+    zs_ring_block,
+    //  Busy-wait; lowest latency, but burns a core while waiting
+    zs_ring_spin,
+    //  Busy-wait, giving up the CPU on every retry
+    zs_ring_yield
+} zs_ring_mode_t;
+
+//  @interface
+//  Create a new ring that holds up to limit items; the limit is rounded up
+//  to a power of two. Returns the reference if successful, or NULL if
+//  construction failed due to lack of available memory.
+zs_ring_t *
+    zs_ring_new (size_t limit);
+
+//  Destroy the ring and free all memory used by it. Any items still in the
+//  ring are passed to the destructor, if one was set.
+void
+    zs_ring_destroy (zs_ring_t **self_p);
+
+//  Set the backpressure mode; call this before any thread uses the ring.
+void
+    zs_ring_set_mode (zs_ring_t *self, zs_ring_mode_t mode);
+
+//  Set a destructor for items left in the ring when it is destroyed.
+void
+    zs_ring_set_destructor (zs_ring_t *self, czmq_destructor destructor);
+
+//  Producer: push an item onto the ring, waiting while the ring is full.
+//  Returns 0 if OK, or -1 if the ring was closed or the process was
+//  interrupted; the caller then still owns the item.
+int
+    zs_ring_push (zs_ring_t *self, void *item);
+
+//  Consumer: pop the oldest item off the ring, waiting while the ring is
+//  empty. Returns NULL if the ring is closed and empty, or the process was
+//  interrupted.
+void *
+    zs_ring_pop (zs_ring_t *self);
+
+//  Close the ring. Either side may do this; the producer can no longer push
+//  and the consumer gets NULL once it has drained the ring.
+void
+    zs_ring_close (zs_ring_t *self);
+
+//  Return true if the ring was closed.
+bool
+    zs_ring_closed (zs_ring_t *self);
+
+//  Return number of items in the ring; this is a snapshot and may be out of
+//  date by the time the caller looks at it.
+size_t
+    zs_ring_size (zs_ring_t *self);
+
+//  Self test of this class
+void
+    zs_ring_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
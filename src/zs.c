@@ -79,31 +79,117 @@ s_list_possible (void)
 }
 
 
+//  ------------------------------------------------------------------------
+//  Serve sentences from stdin: each line of input gets exactly one line of
+//  output, so other processes can pipeline requests. The output is the
+//  results of the line, an empty line if the line did not complete a
+//  statement, or "E: syntax error" with the offset of the error. We read
+//  input in large blocks, and flush output once per block, not per line.
+
+static int
+s_serve (void)
+{
+    size_t buffer_max = 65536;
+    size_t buffer_size = 0;
+    char *buffer = (char *) malloc (buffer_max);
+    assert (buffer);
+    while (!zctx_interrupted) {
+        //  If the buffer is full, we have a very long line
+        if (buffer_size == buffer_max) {
+            buffer_max *= 2;
+            buffer = (char *) realloc (buffer, buffer_max);
+            assert (buffer);
+        }
+        ssize_t bytes = read (STDIN_FILENO, buffer + buffer_size, buffer_max - buffer_size);
+        if (bytes == -1 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            break;
+        buffer_size += bytes;
+
+        char *line = buffer;
+        char *end;
+        while ((end = (char *) memchr (line, '\n', buffer + buffer_size - line))) {
+            *end = 0;
+            if (end > line && end [-1] == '\r')
+                end [-1] = 0;
+            if (zs_repl_execute (repl, line))
+                printf ("E: syntax error at %u\n", zs_repl_offset (repl));
+            else
+            if (zs_repl_completed (repl))
+                puts (zs_repl_results (repl));
+            else
+                putchar ('\n');
+            line = end + 1;
+        }
+        fflush (stdout);
+        //  Keep any partial line for the next block
+        buffer_size -= line - buffer;
+        memmove (buffer, line, buffer_size);
+    }
+    free (buffer);
+    return 0;
+}
+
+
 int main (int argc, char *argv [])
 {
     int argn = 1;
     bool verbose = false;
-    if (argn < argc && streq (argv [argn], "-v")) {
-        verbose = true;
+    const char *script = NULL;
+    bool serve = false;
+    //  Anything that isn't one of our options starts the sentence, which
+    //  may well begin with a negative number
+    while (argn < argc) {
+        if (streq (argv [argn], "-v"))
+            verbose = true;
+        else
+        if (streq (argv [argn], "-f") && argn + 1 < argc)
+            script = argv [++argn];
+        else
+        if (streq (argv [argn], "--serve"))
+            serve = true;
+        else
+        if (streq (argv [argn], "-h") || streq (argv [argn], "-f")) {
+            puts ("Usage: zs [ -v ] [ -f script | --serve | sentence ... ]");
+            puts ("    -v            trace the lexer, compiler, and virtual machine");
+            puts ("    -f script     execute script file, - for stdin");
+            puts ("    --serve       execute lines from stdin, one line of results each");
+            return streq (argv [argn], "-h")? 0: 1;
+        }
+        else
+            break;
         argn++;
     }
-    if (argn < argc && streq (argv [argn], "-h")) {
-        puts ("Usage: zs [ -v ]");
-        return 0;
-    }
     //  Main thread is read/parse/execute input text
     zsys_init ();
     repl = zs_repl_new ();
     zs_repl_verbose (repl, verbose);
 
-    //  Set-up the command line
-    read_history (HISTORY);
-    rl_set_complete_func (&s_complete_func);
-    rl_set_list_possib_func (&s_list_possib_func);
-    el_bind_key ('?', s_list_possible);
-
-    //  If run with arguments, treat as script to execute
+    int rc = 0;
+    if (script) {
+        //  Batch mode, print results of each statement
+        rc = streq (script, "-")
+           ? zs_repl_execute_stream (repl, stdin, stdout)
+           : zs_repl_execute_file (repl, script, stdout);
+        if (rc) {
+            if (zs_repl_line (repl))
+                fprintf (stderr, "E: %s:%zu: syntax error or incomplete statement\n",
+                         script, zs_repl_line (repl));
+            else
+                fprintf (stderr, "E: can't read %s\n", script);
+            rc = 1;
+        }
+    }
+    else
+    if (serve) {
+        //  Server mode, for other processes to talk to us
+        setvbuf (stdout, NULL, _IOFBF, 65536);
+        rc = s_serve ();
+    }
+    else
     if (argn < argc) {
+        //  If run with arguments, treat as script to execute
         char input [1024 + 2] = "";
         while (argn < argc) {
             strncat (input, argv [argn++], 1024);
@@ -119,6 +205,12 @@ int main (int argc, char *argv [])
         }
     }
     else {
+        //  Set-up the command line
+        read_history (HISTORY);
+        rl_set_complete_func (&s_complete_func);
+        rl_set_list_possib_func (&s_list_possib_func);
+        el_bind_key ('?', s_list_possible);
+
         //  If run without arguments, drop into REPL shell
         while (!zctx_interrupted) {
             char *prompt = zs_repl_completed (repl)? "> ": ": ";
@@ -139,8 +231,8 @@ int main (int argc, char *argv [])
             }
             free (input);
         }
+        write_history (HISTORY);
     }
-    write_history (HISTORY);
     zs_repl_destroy (&repl);
-    return 0;
+    return rc;
 }
@@ -19,12 +19,17 @@
 static int
 s_check (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "check", zs_type_nullary, "Run internal checks");
+        zs_vm_register_signature (self, "", "s", 1, zs_effect_writes);
+    }
     else {
         int verbose = (zs_pipe_recv_whole (input) != 0);
         zs_lex_test (verbose);
         zs_pipe_test (verbose);
+        zs_ring_test (verbose);
+        zs_pool_test (verbose);
+        zs_trace_test (verbose);
         zs_vm_test (verbose);
         zs_repl_test (verbose);
         zs_pipe_send_string (output, "Checks passed successfully");
@@ -38,20 +43,100 @@ s_check (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 static int
 s_debug (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "debug", zs_type_modest, "Trace pipe state in detail");
+        zs_vm_register_signature (self, "w", "", 0, zs_effect_writes);
+    }
     else
         zs_vm_trace_pipes (self, (zs_pipe_recv_whole (input) > 0));
     return 0;
 }
 
 
+static int
+s_connect (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "connect", zs_type_modest, "Send sentences to named port");
+        zs_vm_register_signature (self, "s", "", 0, zs_effect_writes);
+    }
+    else {
+        const char *name = zs_pipe_recv_string (input);
+        if (zs_vm_connect (self, name? name: "")) {
+            printf ("E: no such port '%s'\n", name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int
+s_profile (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "profile", zs_type_modest, "Collect execution profile");
+        zs_vm_register_signature (self, "w", "", 0, zs_effect_writes);
+    }
+    else
+        zs_vm_set_profile (self, (zs_pipe_recv_whole (input) > 0));
+    return 0;
+}
+
+
+//  N trace starts tracing the last N instructions; 0 trace prints the
+//  trace and stops tracing
+static int
+s_trace (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "trace", zs_type_modest, "Trace last instructions");
+        zs_vm_register_signature (self, "w", "", 0, zs_effect_writes);
+    }
+    else {
+        int64_t limit = zs_pipe_recv_whole (input);
+        if (limit <= 0)
+            zs_vm_trace_print (self, stdout, false);
+        zs_vm_set_trace (self, limit > 0? (size_t) limit: 0);
+    }
+    return 0;
+}
+
+//  Prints the N most expensive atomics and functions, e.g. 5 top
+static int
+s_top (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "top", zs_type_modest, "Print top of execution profile");
+        zs_vm_register_signature (self, "w", "", 0, zs_effect_writes);
+    }
+    else {
+        int64_t limit = zs_pipe_recv (input)? zs_pipe_whole (input): 10;
+        printf ("%12s %12s %12s  %s\n", "calls", "total ms", "avg ns", "name");
+        const char *name = zs_vm_profile_first (self);
+        while (name && limit > 0) {
+            //  Skip the shell's own wrapper functions
+            if (*name != '$') {
+                uint64_t calls = zs_vm_profile_calls (self);
+                uint64_t nanos = zs_vm_profile_nanos (self);
+                printf ("%12" PRIu64 " %12.3f %12" PRIu64 "  %s\n",
+                        calls, nanos / 1e6, nanos / calls, name);
+                limit--;
+            }
+            name = zs_vm_profile_next (self);
+        }
+    }
+    return 0;
+}
+
 //  This is the times {} loop function
 static int
 s_times (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "times", zs_type_modest, "Loop N times");
+        zs_vm_register_signature (self, "w", "w", ZS_ARITY_ANY, zs_effect_pure);
+    }
     else {
         int64_t cycles = zs_pipe_recv_whole (input);
         zs_pipe_mark (output);
@@ -73,8 +158,10 @@ s_times (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 static int
 s_count (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "count", zs_type_modest, "Loop N times, counting");
+        zs_vm_register_signature (self, "w", "w", ZS_ARITY_ANY, zs_effect_pure);
+    }
     else {
         int64_t cycles = zs_pipe_recv_whole (input);
         //  Get optional index start and delta from input
@@ -107,8 +194,10 @@ s_count (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 static int
 s_countdown (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "countdown", zs_type_modest, "Loop N times, counting dow");
+        zs_vm_register_signature (self, "w", "w", ZS_ARITY_ANY, zs_effect_pure);
+    }
     else {
         int64_t cycles = zs_pipe_recv_whole (input);
         if (cycles > 0) {
@@ -133,11 +222,24 @@ s_countdown (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 //  ---------------------------------------------------------------------------
 //  Greedy functions
 
+static int
+s_sum_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t sum = 0;
+    while (zs_pipe_recv (input))
+        sum += zs_pipe_whole (input);
+    zs_pipe_send_whole (output, sum);
+    return 0;
+}
+
 static int
 s_sum (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "sum", zs_type_greedy, "Sum of the values");
+        zs_vm_register_signature (self, "wrs", "wr", 1, zs_effect_pure);
+        zs_vm_register_whole (self, s_sum_whole);
+    }
     else
     if (zs_pipe_realish (input)) {
         double sum = 0;
@@ -145,20 +247,18 @@ s_sum (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
             sum += zs_pipe_real (input);
         zs_pipe_send_real (output, sum);
     }
-    else {
-        int64_t sum = 0;
-        while (zs_pipe_recv (input))
-            sum += zs_pipe_whole (input);
-        zs_pipe_send_whole (output, sum);
-    }
+    else
+        s_sum_whole (self, input, output);
     return 0;
 }
 
 static int
 s_product (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "product", zs_type_greedy, "Product of the values");
+        zs_vm_register_signature (self, "wrs", "wr", 1, zs_effect_pure);
+    }
     else
     if (zs_pipe_realish (input)) {
         double product = 1;
@@ -178,8 +278,10 @@ s_product (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 static int
 s_tally (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "tally", zs_type_greedy, "Number of values");
+        zs_vm_register_signature (self, "wrs", "w", 1, zs_effect_pure);
+    }
     else {
         int64_t tally = 0;
         while (zs_pipe_recv (input))
@@ -192,8 +294,10 @@ s_tally (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 static int
 s_mean (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "mean", zs_type_greedy, "Mean of the values");
+        zs_vm_register_signature (self, "wrs", "r", 1, zs_effect_pure);
+    }
     else {
         double total = 0;
         double tally = 0;
@@ -206,11 +310,26 @@ s_mean (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_min_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t result = zs_pipe_recv_whole (input);
+    while (zs_pipe_recv (input)) {
+        if (result > zs_pipe_whole (input))
+            result = zs_pipe_whole (input);
+    }
+    zs_pipe_send_whole (output, result);
+    return 0;
+}
+
 static int
 s_min (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "min", zs_type_greedy, "Minimum of the values");
+        zs_vm_register_signature (self, "wrs", "wr", 1, zs_effect_pure);
+        zs_vm_register_whole (self, s_min_whole);
+    }
     else
     if (zs_pipe_realish (input)) {
         double result = zs_pipe_recv_whole (input);
@@ -220,22 +339,31 @@ s_min (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         }
         zs_pipe_send_real (output, result);
     }
-    else {
-        int64_t result = zs_pipe_recv_whole (input);
-        while (zs_pipe_recv (input)) {
-            if (result > zs_pipe_whole (input))
-                result = zs_pipe_whole (input);
-        }
-        zs_pipe_send_whole (output, result);
+    else
+        s_min_whole (self, input, output);
+    return 0;
+}
+
+static int
+s_max_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t result = zs_pipe_recv_whole (input);
+    while (zs_pipe_recv (input)) {
+        if (result < zs_pipe_whole (input))
+            result = zs_pipe_whole (input);
     }
+    zs_pipe_send_whole (output, result);
     return 0;
 }
 
 static int
 s_max (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "max", zs_type_greedy, "Maximum of the values");
+        zs_vm_register_signature (self, "wrs", "wr", 1, zs_effect_pure);
+        zs_vm_register_whole (self, s_max_whole);
+    }
     else
     if (zs_pipe_realish (input)) {
         double result = zs_pipe_recv_whole (input);
@@ -245,22 +373,18 @@ s_max (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         }
         zs_pipe_send_real (output, result);
     }
-    else {
-        int64_t result = zs_pipe_recv_whole (input);
-        while (zs_pipe_recv (input)) {
-            if (result < zs_pipe_whole (input))
-                result = zs_pipe_whole (input);
-        }
-        zs_pipe_send_whole (output, result);
-    }
+    else
+        s_max_whole (self, input, output);
     return 0;
 }
 
 static int
 s_assert (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "assert", zs_type_greedy, "Assert first two values are the same");
+        zs_vm_register_signature (self, "wrs", "", 0, zs_effect_writes);
+    }
     else
     if (zs_pipe_realish (input)) {
         double first = zs_pipe_recv_real (input);
@@ -281,15 +405,24 @@ s_assert (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_whole_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input));
+    return 0;
+}
+
 static int
 s_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "whole", zs_type_greedy, "Coerce values to whole numbers");
-    else {
-        while (zs_pipe_recv (input))
-            zs_pipe_send_whole (output, zs_pipe_whole (input));
+        zs_vm_register_signature (self, "wrs", "w", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_whole_whole);
     }
+    else
+        s_whole_whole (self, input, output);
     return 0;
 }
 
@@ -297,12 +430,23 @@ s_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 //  ---------------------------------------------------------------------------
 //  Array functions
 
+static int
+s_add_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t operand = zs_pipe_recv_whole (input);
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) + operand);
+    return 0;
+}
+
 static int
 s_add (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "+", zs_type_array, "Add value to all");
         zs_vm_register (self, "add", zs_type_array, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_ANY, zs_effect_pure);
+        zs_vm_register_whole (self, s_add_whole);
     }
     else
     if (zs_pipe_realish (input)) {
@@ -310,11 +454,17 @@ s_add (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         while (zs_pipe_recv (input))
             zs_pipe_send_real (output, zs_pipe_real (input) + operand);
     }
-    else {
-        int64_t operand = zs_pipe_recv_whole (input);
-        while (zs_pipe_recv (input))
-            zs_pipe_send_whole (output, zs_pipe_whole (input) + operand);
-    }
+    else
+        s_add_whole (self, input, output);
+    return 0;
+}
+
+static int
+s_subtract_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t operand = zs_pipe_recv_whole (input);
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) - operand);
     return 0;
 }
 
@@ -324,6 +474,8 @@ s_subtract (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "-", zs_type_array, "Subtract value from all");
         zs_vm_register (self, "subtract", zs_type_array, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_ANY, zs_effect_pure);
+        zs_vm_register_whole (self, s_subtract_whole);
     }
     else
     if (zs_pipe_realish (input)) {
@@ -331,11 +483,17 @@ s_subtract (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         while (zs_pipe_recv (input))
             zs_pipe_send_real (output, zs_pipe_real (input) - operand);
     }
-    else {
-        int64_t operand = zs_pipe_recv_whole (input);
-        while (zs_pipe_recv (input))
-            zs_pipe_send_whole (output, zs_pipe_whole (input) - operand);
-    }
+    else
+        s_subtract_whole (self, input, output);
+    return 0;
+}
+
+static int
+s_multiply_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t operand = zs_pipe_recv_whole (input);
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * operand);
     return 0;
 }
 
@@ -346,6 +504,8 @@ s_multiply (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         zs_vm_register (self, "*", zs_type_array, "Multiply value by all");
         zs_vm_register (self, "x", zs_type_array, NULL);
         zs_vm_register (self, "multiply", zs_type_array, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_ANY, zs_effect_pure);
+        zs_vm_register_whole (self, s_multiply_whole);
     }
     else
     if (zs_pipe_realish (input)) {
@@ -353,11 +513,8 @@ s_multiply (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
         while (zs_pipe_recv (input))
             zs_pipe_send_real (output, zs_pipe_real (input) * operand);
     }
-    else {
-        int64_t operand = zs_pipe_recv_whole (input);
-        while (zs_pipe_recv (input))
-            zs_pipe_send_whole (output, zs_pipe_whole (input) * operand);
-    }
+    else
+        s_multiply_whole (self, input, output);
     return 0;
 }
 
@@ -367,6 +524,7 @@ s_divide (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/", zs_type_array, "Divide value into all");
         zs_vm_register (self, "divide", zs_type_array, NULL);
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_ANY, zs_effect_pure);
     }
     else {
         double operand = zs_pipe_recv_real (input);
@@ -376,6 +534,27 @@ s_divide (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+//  Applies a user function to the rest of the phrase, in chunks spread
+//  across worker threads, e.g. 1 2 3 4 <double> pmap
+static int
+s_pmap (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "pmap", zs_type_array, "Map function over values in parallel");
+        zs_vm_register_signature (self, "wrs", "wrs", ZS_ARITY_ANY, zs_effect_writes);
+    }
+    else {
+        const char *string = zs_pipe_recv_string (input);
+        char *name = strdup (string? string: "");
+        int rc = zs_vm_pmap (self, name, input, output);
+        if (rc)
+            printf ("E: pmap could not apply '%s'\n", name);
+        free (name);
+        return rc;
+    }
+    return 0;
+}
+
 
 static void
 s_register_atomics (zs_vm_t *self)
@@ -383,6 +562,10 @@ s_register_atomics (zs_vm_t *self)
     zs_vm_probe (self, s_check);
 
     zs_vm_probe (self, s_debug);
+    zs_vm_probe (self, s_connect);
+    zs_vm_probe (self, s_profile);
+    zs_vm_probe (self, s_top);
+    zs_vm_probe (self, s_trace);
     zs_vm_probe (self, s_times);
     zs_vm_probe (self, s_count);
     zs_vm_probe (self, s_countdown);
@@ -400,5 +583,6 @@ s_register_atomics (zs_vm_t *self)
     zs_vm_probe (self, s_subtract);
     zs_vm_probe (self, s_multiply);
     zs_vm_probe (self, s_divide);
+    zs_vm_probe (self, s_pmap);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,1104 @@
+/*  =========================================================================
+    zs_bench.c - run benchmarks
+
+    Runs micro and macro benchmarks over the lexer, compiler, virtual
+    machine, and pipes, and prints the results as JSON, so that we can
+    compare results between releases. With --compare, checks the results
+    against a saved baseline and fails if any benchmark got slower.
+
+    -------------------------------------------------------------------------
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript experiment.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#include "zs_classes.h"
+#if defined (__linux__)
+#   include <sched.h>
+#endif
+#if defined (__GLIBC__)
+#   include <malloc.h>
+#endif
+
+//  Each benchmark runs its workload the requested number of loops, and
+//  returns the number of operations it did, in its own unit.
+
+typedef struct {
+    size_t loops;                   //  How many times to repeat the work
+    size_t param;                   //  Benchmark parameter, e.g. pipe size
+    uint64_t cycles;                //  Lexer FSM cycles used, if any
+    double heap;                    //  Heap bytes held per operation, if any
+    uint64_t started;               //  When the timed work started
+    uint64_t elapsed;               //  Nanoseconds the timed work took
+} s_run_t;
+
+typedef size_t (s_bench_fn) (s_run_t *run);
+
+typedef struct {
+    const char *name;               //  Benchmark name, group.case
+    const char *unit;               //  What one operation is
+    s_bench_fn *fn;                 //  Runs the benchmark
+    size_t param;                   //  Passed to the benchmark
+} s_bench_t;
+
+//  Return monotonic time in nanoseconds
+static uint64_t
+s_now (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+//  Each benchmark calls s_start and s_stop around the work it times, so
+//  that setting up and tearing down its objects does not count.
+static void
+s_start (s_run_t *run)
+{
+    run->started = s_now ();
+}
+
+static void
+s_stop (s_run_t *run)
+{
+    run->elapsed = s_now () - run->started;
+}
+
+//  A benchmark whose work fails would report nonsense, so we stop
+static void
+s_failed (const char *what)
+{
+    fprintf (stderr, "E: benchmark failed in %s\n", what);
+    exit (1);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Lexer: tokens per second over a script that uses every kind of token
+
+static char *
+s_lex_script (void)
+{
+    const char *line = "fn: (1 2.5 -3 10% <hello> sum (4 5), 6 [7 | 8]"
+                       " 3 times { 9 } tally). ";
+    size_t count = 100;
+    char *script = (char *) zmalloc (strlen (line) * count + 1);
+    assert (script);
+    size_t index;
+    for (index = 0; index < count; index++)
+        strcat (script, line);
+    return script;
+}
+
+static size_t
+s_bench_lex (s_run_t *run)
+{
+    char *script = s_lex_script ();
+    zs_lex_t *lex = zs_lex_new ();
+    size_t tokens = 0;
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        zs_lex_token_t token = zs_lex_first (lex, script);
+        while (token != zs_lex_null) {
+            assert (token != zs_lex_invalid);
+            tokens++;
+            token = zs_lex_next (lex);
+        }
+    }
+    s_stop (run);
+    run->cycles = zs_lex_cycles (lex);
+    zs_lex_destroy (&lex);
+    free (script);
+    return tokens;
+}
+
+
+//  Lexer: bytes per second over a multi-megabyte script, written the way
+//  people write longer scripts, with indentation, comments, long names,
+//  and longer strings
+
+static char *
+s_lex_file (void)
+{
+    const char *lines =
+        "#   Compute the monthly summary for each account\n"
+        "monthly-summary: (\n"
+        "    account-balances (1200.50 -340.25 18% 1,000,000) sum,\n"
+        "    <Summary for the month, with totals by account and category>\n"
+        "    interest_rate * 12 [ <overdrawn> | <in credit> ]\n"
+        "    12 times { opening-balance closing-balance difference } tally\n"
+        ").\n"
+        "\n";
+    size_t count = 4 * 1024 * 1024 / strlen (lines);
+    char *script = (char *) zmalloc (strlen (lines) * count + 1);
+    assert (script);
+    char *target = script;
+    size_t index;
+    for (index = 0; index < count; index++) {
+        strcpy (target, lines);
+        target += strlen (lines);
+    }
+    return script;
+}
+
+static size_t
+s_bench_lex_file (s_run_t *run)
+{
+    char *script = s_lex_file ();
+    zs_lex_t *lex = zs_lex_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        zs_lex_token_t token = zs_lex_first (lex, script);
+        while (token != zs_lex_null) {
+            assert (token != zs_lex_invalid);
+            token = zs_lex_next (lex);
+        }
+    }
+    s_stop (run);
+    size_t bytes = run->loops * strlen (script);
+    run->cycles = zs_lex_cycles (lex);
+    zs_lex_destroy (&lex);
+    free (script);
+    return bytes;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Compiler: statements per second through zs_repl_execute; each statement
+//  is compiled, run, and rolled back, and the run does very little.
+
+static size_t
+s_bench_compile (s_run_t *run)
+{
+    const char *statement = "1 2 3 4 5 6 7 8, <a> <b> <c> <d>, 1.5 2.5 3.5,"
+                            " tally (sum (1 2) product (3 4) 5) 0 [1 2] 1 [3]";
+    zs_repl_t *repl = zs_repl_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_repl_execute (repl, statement))
+            s_failed ("zs_repl_execute");
+    s_stop (run);
+    zs_repl_destroy (&repl);
+    return run->loops;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Virtual machine: instructions per second, for one kind of instruction at
+//  a time. Each run executes a function holding many copies of it.
+
+#define DISPATCH_COPIES 1000
+
+typedef enum {
+    s_dispatch_whole,
+    s_dispatch_real,
+    s_dispatch_string,
+    s_dispatch_atomic,
+    s_dispatch_call,
+    s_dispatch_wrapper,
+    s_dispatch_phrase,
+    s_dispatch_nest,
+    s_dispatch_sentence,
+    s_dispatch_operand
+} s_dispatch_t;
+
+static int
+s_nop (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self))
+        zs_vm_register (self, "nop", zs_type_nullary, "Do nothing");
+    return 0;
+}
+
+//  Modest function that passes its value on, as unit scaling does
+static int
+s_same (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self))
+        zs_vm_register (self, "same", zs_type_modest, "Pass value through");
+    else
+        zs_pipe_send_whole (output, zs_pipe_recv_whole (input));
+    return 0;
+}
+
+static size_t
+s_bench_dispatch (s_run_t *run)
+{
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_probe (vm, s_nop);
+    zs_vm_probe (vm, s_same);
+    //  We measure each instruction as compiled, without the peephole pass
+    zs_vm_set_peephole (vm, false);
+    //  vm.call measures real calls, so we don't let the compiler inline them
+    if (run->param == s_dispatch_call)
+        zs_vm_set_inline (vm, 0);
+    zs_vm_compile_define (vm, "leaf");
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "wrap");
+    zs_vm_compile_inline (vm, "nop");
+    zs_vm_commit (vm);
+
+    zs_vm_compile_define (vm, "main");
+    size_t copy;
+    for (copy = 0; copy < DISPATCH_COPIES; copy++) {
+        switch ((s_dispatch_t) run->param) {
+            case s_dispatch_whole:
+                zs_vm_compile_whole (vm, copy);
+                break;
+            case s_dispatch_real:
+                zs_vm_compile_real (vm, copy / 10.0);
+                break;
+            case s_dispatch_string:
+                zs_vm_compile_string (vm, "hello");
+                break;
+            case s_dispatch_atomic:
+                zs_vm_compile_inline (vm, "nop");
+                break;
+            case s_dispatch_call:
+                zs_vm_compile_inline (vm, "leaf");
+                break;
+            case s_dispatch_wrapper:
+                zs_vm_compile_inline (vm, "wrap");
+                break;
+            case s_dispatch_phrase:
+                zs_vm_compile_phrase (vm);
+                break;
+            case s_dispatch_nest:
+                zs_vm_compile_nest (vm, "nop");
+                zs_vm_compile_xnest (vm);
+                break;
+            case s_dispatch_sentence:
+                zs_vm_compile_sentence (vm);
+                break;
+            case s_dispatch_operand:
+                zs_vm_compile_whole (vm, copy);
+                zs_vm_compile_inline (vm, "same");
+                break;
+        }
+    }
+    zs_vm_commit (vm);
+
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_vm_run (vm))
+            s_failed ("zs_vm_run");
+    s_stop (run);
+    zs_vm_destroy (&vm);
+    return run->loops * DISPATCH_COPIES;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Peephole pass: instructions per second for code that each rewrite
+//  improves, with the pass on, and with it off for comparison.
+
+#define PEEPHOLE_OFF 0x10
+
+typedef enum {
+    s_peephole_constants,           //  1 2.5 <hello> ...
+    s_peephole_unloop,              //  tick { }
+    s_peephole_jumps                //  0 [ ] link
+} s_peephole_t;
+
+//  Nullary loop function that continues until its budget runs out
+static int64_t s_ticks = 0;
+
+static int
+s_tick (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self))
+        zs_vm_register (self, "tick", zs_type_nullary, "Loop until budget is spent");
+    else {
+        zs_pipe_mark (output);
+        zs_pipe_send_whole (output, s_ticks-- > 0);
+    }
+    return 0;
+}
+
+static size_t
+s_bench_peephole (s_run_t *run)
+{
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_probe (vm, s_tick);
+    zs_vm_set_inline (vm, 0);
+    zs_vm_set_peephole (vm, !(run->param & PEEPHOLE_OFF));
+    s_peephole_t rewrite = (s_peephole_t) (run->param & ~PEEPHOLE_OFF);
+    size_t copy;
+    if (rewrite == s_peephole_jumps) {
+        //  Each link tests a menu, which jumps to the tail call
+        zs_vm_compile_define (vm, "link");
+        zs_vm_commit (vm);
+        for (copy = 0; copy < DISPATCH_COPIES; copy++) {
+            zs_vm_compile_define (vm, "link");
+            zs_vm_compile_whole  (vm, 0);
+            zs_vm_compile_menu   (vm);
+            zs_vm_compile_xmenu  (vm);
+            zs_vm_compile_inline (vm, "link");
+            zs_vm_commit (vm);
+        }
+    }
+    else {
+        zs_vm_compile_define (vm, "main");
+        if (rewrite == s_peephole_unloop) {
+            zs_vm_compile_inline (vm, "tick");
+            zs_vm_compile_loop   (vm, "tick");
+            zs_vm_compile_xloop  (vm);
+        }
+        else
+        for (copy = 0; copy < DISPATCH_COPIES; copy++) {
+            zs_vm_compile_whole  (vm, copy);
+            zs_vm_compile_real   (vm, copy / 10.0);
+            zs_vm_compile_string (vm, "hello");
+        }
+        zs_vm_commit (vm);
+    }
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_ticks = DISPATCH_COPIES;
+        if (zs_vm_run (vm))
+            s_failed ("zs_vm_run");
+    }
+    s_stop (run);
+    zs_vm_destroy (&vm);
+    return run->loops * DISPATCH_COPIES;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Typed variants: calls per second to a greedy atomic on whole numbers,
+//  with the types pass on, and with it off for comparison.
+
+#define SPECIALIZE_OFF 0x10
+
+static int
+s_total_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t total = 0;
+    while (zs_pipe_recv (input))
+        total += zs_pipe_whole (input);
+    zs_pipe_send_whole (output, total);
+    return 0;
+}
+
+//  Greedy function that adds up its values, as sum does
+static int
+s_total (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "total", zs_type_greedy, "Add up the values");
+        zs_vm_register_whole (self, s_total_whole);
+    }
+    else
+    if (zs_pipe_realish (input)) {
+        double total = 0;
+        while (zs_pipe_recv (input))
+            total += zs_pipe_real (input);
+        zs_pipe_send_real (output, total);
+    }
+    else
+        s_total_whole (self, input, output);
+    return 0;
+}
+
+static size_t
+s_bench_specialize (s_run_t *run)
+{
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_probe (vm, s_total);
+    zs_vm_set_specialize (vm, !(run->param & SPECIALIZE_OFF));
+    zs_vm_compile_define (vm, "main");
+    size_t copy;
+    for (copy = 0; copy < DISPATCH_COPIES; copy++) {
+        zs_vm_compile_nest  (vm, "total");
+        zs_vm_compile_whole (vm, copy);
+        zs_vm_compile_whole (vm, 2);
+        zs_vm_compile_whole (vm, 3);
+        zs_vm_compile_xnest (vm);
+    }
+    zs_vm_commit (vm);
+
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_vm_run (vm))
+            s_failed ("zs_vm_run");
+    s_stop (run);
+    zs_vm_destroy (&vm);
+    return run->loops * DISPATCH_COPIES;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Virtual machine: chained calls per second, where each function ends by
+//  calling the one before it, as state machines do. Tail calls turn these
+//  into jumps.
+
+#define CHAIN_LENGTH 1000
+
+static size_t
+s_bench_chain (s_run_t *run)
+{
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_probe (vm, s_nop);
+    zs_vm_set_inline (vm, 0);
+    zs_vm_compile_define (vm, "link");
+    zs_vm_commit (vm);
+    size_t link;
+    for (link = 0; link < CHAIN_LENGTH; link++) {
+        zs_vm_compile_define (vm, "link");
+        zs_vm_compile_inline (vm, "nop");
+        zs_vm_compile_inline (vm, "link");
+        zs_vm_commit (vm);
+    }
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_vm_run (vm))
+            s_failed ("zs_vm_run");
+    s_stop (run);
+    zs_vm_destroy (&vm);
+    return run->loops * CHAIN_LENGTH;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Footprint: virtual machines and repl sessions created per second, and
+//  the heap each one holds before it runs anything. We keep a batch alive
+//  at a time, and measure the heap over the first batch.
+
+#define FOOTPRINT_BATCH 100
+
+//  Return heap bytes in use, or 0 if we can't tell
+static size_t
+s_heap_used (void)
+{
+#if defined (__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2 ();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static size_t
+s_bench_vm_new (s_run_t *run)
+{
+    zs_vm_t *vms [FOOTPRINT_BATCH];
+    size_t created = 0;
+    s_start (run);
+    while (created < run->loops) {
+        size_t batch = run->loops - created;
+        if (batch > FOOTPRINT_BATCH)
+            batch = FOOTPRINT_BATCH;
+        size_t heap = s_heap_used ();
+        size_t index;
+        for (index = 0; index < batch; index++)
+            vms [index] = zs_vm_new ();
+        if (created == 0)
+            run->heap = (double) (s_heap_used () - heap) / batch;
+        for (index = 0; index < batch; index++)
+            zs_vm_destroy (&vms [index]);
+        created += batch;
+    }
+    s_stop (run);
+    return created;
+}
+
+//  Sessions fork off a repl that holds all the atomics, as a server would
+static size_t
+s_bench_repl_fork (s_run_t *run)
+{
+    zs_repl_t *repl = zs_repl_new ();
+    zs_repl_t *sessions [FOOTPRINT_BATCH];
+    size_t created = 0;
+    s_start (run);
+    while (created < run->loops) {
+        size_t batch = run->loops - created;
+        if (batch > FOOTPRINT_BATCH)
+            batch = FOOTPRINT_BATCH;
+        size_t heap = s_heap_used ();
+        size_t index;
+        for (index = 0; index < batch; index++)
+            sessions [index] = zs_repl_fork (repl);
+        if (created == 0)
+            run->heap = (double) (s_heap_used () - heap) / batch;
+        for (index = 0; index < batch; index++)
+            zs_repl_destroy (&sessions [index]);
+        created += batch;
+    }
+    s_stop (run);
+    zs_repl_destroy (&repl);
+    return created;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Pipes: values per second through each pipe operation, at one size
+
+static void
+s_fill (zs_pipe_t *pipe, size_t size)
+{
+    size_t index;
+    for (index = 0; index < size; index++)
+        zs_pipe_send_whole (pipe, index);
+}
+
+static size_t
+s_bench_send_recv (s_run_t *run)
+{
+    zs_pipe_t *pipe = zs_pipe_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_fill (pipe, run->param);
+        while (zs_pipe_recv (pipe))
+            assert (zs_pipe_type (pipe) == 'w');
+    }
+    s_stop (run);
+    zs_pipe_destroy (&pipe);
+    return run->loops * run->param;
+}
+
+static size_t
+s_bench_pull (s_run_t *run)
+{
+    zs_pipe_t *source = zs_pipe_new ();
+    zs_pipe_t *pipe = zs_pipe_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_fill (source, run->param);
+        zs_pipe_pull_greedy (pipe, source);
+        zs_pipe_purge (pipe);
+    }
+    s_stop (run);
+    zs_pipe_destroy (&source);
+    zs_pipe_destroy (&pipe);
+    return run->loops * run->param;
+}
+
+static size_t
+s_bench_paste (s_run_t *run)
+{
+    zs_pipe_t *pipe = zs_pipe_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_fill (pipe, run->param);
+        char *results = zs_pipe_paste (pipe);
+        zstr_free (&results);
+    }
+    s_stop (run);
+    zs_pipe_destroy (&pipe);
+    return run->loops * run->param;
+}
+
+static size_t
+s_bench_encode (s_run_t *run)
+{
+    zs_pipe_t *pipe = zs_pipe_new ();
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_fill (pipe, run->param);
+        zchunk_t *chunk = zs_pipe_encode (pipe);
+        if (zs_pipe_decode (pipe, zchunk_data (chunk), zchunk_size (chunk)))
+            s_failed ("zs_pipe_decode");
+        zchunk_destroy (&chunk);
+        zs_pipe_purge (pipe);
+    }
+    s_stop (run);
+    zs_pipe_destroy (&pipe);
+    return run->loops * run->param;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Scripts: a corpus of statements that we lex, compile and run end to end
+//  through zs_repl_execute, and also compile once and then just run.
+
+typedef struct {
+    const char *setup;              //  Defines functions, if needed
+    const char *script;             //  Statement we time
+    const char *results;            //  What it should produce
+} s_script_t;
+
+static s_script_t
+s_scripts [] = {
+    { NULL, "1000 times { 1 2 3 sum } sum", "6000" },
+    { NULL, "100 count { } sum", "5050" },
+    { "double: (2 *)", "double (double (1 2 3 4 5 6 7 8 9 10)) sum", "220" },
+    { "fib: (1 1 2 3 5 8 13 21)", "100 times { fib sum } sum", "5400" },
+    { NULL, "100 times { <hello> <world> } tally", "200" },
+    { NULL, "100 times { 1 [1 2] 0 [3] } tally", "200" },
+    { NULL }
+};
+
+static size_t
+s_bench_script (s_run_t *run)
+{
+    s_script_t *script = &s_scripts [run->param];
+    zs_repl_t *repl = zs_repl_new ();
+    if (script->setup)
+        zs_repl_execute (repl, script->setup);
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_repl_execute (repl, script->script))
+            s_failed (script->script);
+    s_stop (run);
+    assert (streq (zs_repl_results (repl), script->results));
+    zs_repl_destroy (&repl);
+    return run->loops;
+}
+
+//  Compile the script once as a function, so each statement we time only
+//  calls it, and nearly all the time goes to zs_vm_run
+static size_t
+s_bench_run (s_run_t *run)
+{
+    s_script_t *script = &s_scripts [run->param];
+    zs_repl_t *repl = zs_repl_new ();
+    if (script->setup)
+        zs_repl_execute (repl, script->setup);
+    char *main = zsys_sprintf ("main: (%s)", script->script);
+    zs_repl_execute (repl, main);
+    zstr_free (&main);
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++)
+        if (zs_repl_execute (repl, "main"))
+            s_failed (script->script);
+    s_stop (run);
+    assert (streq (zs_repl_results (repl), script->results));
+    zs_repl_destroy (&repl);
+    return run->loops;
+}
+
+//  Lex the whole corpus
+static size_t
+s_bench_lex_corpus (s_run_t *run)
+{
+    zs_lex_t *lex = zs_lex_new ();
+    size_t tokens = 0;
+    size_t loop;
+    s_start (run);
+    for (loop = 0; loop < run->loops; loop++) {
+        s_script_t *script;
+        for (script = s_scripts; script->script; script++) {
+            zs_lex_token_t token = zs_lex_first (lex, script->script);
+            while (token != zs_lex_null) {
+                assert (token != zs_lex_invalid);
+                tokens++;
+                token = zs_lex_next (lex);
+            }
+        }
+    }
+    s_stop (run);
+    run->cycles = zs_lex_cycles (lex);
+    zs_lex_destroy (&lex);
+    return tokens;
+}
+
+
+static s_bench_t
+s_benchmarks [] = {
+    { "lex.tokens",             "token",        s_bench_lex,        0 },
+    { "lex.corpus",             "token",        s_bench_lex_corpus, 0 },
+    { "lex.file",               "byte",         s_bench_lex_file,   0 },
+    { "compile.statement",      "statement",    s_bench_compile,    0 },
+    { "vm.whole",               "instruction",  s_bench_dispatch,   s_dispatch_whole },
+    { "vm.real",                "instruction",  s_bench_dispatch,   s_dispatch_real },
+    { "vm.string",              "instruction",  s_bench_dispatch,   s_dispatch_string },
+    { "vm.atomic",              "call",         s_bench_dispatch,   s_dispatch_atomic },
+    { "vm.call",                "call",         s_bench_dispatch,   s_dispatch_call },
+    { "vm.wrapper",             "call",         s_bench_dispatch,   s_dispatch_wrapper },
+    { "vm.phrase",              "instruction",  s_bench_dispatch,   s_dispatch_phrase },
+    { "vm.nest",                "call",         s_bench_dispatch,   s_dispatch_nest },
+    { "vm.sentence",            "instruction",  s_bench_dispatch,   s_dispatch_sentence },
+    { "vm.operand",             "phrase",       s_bench_dispatch,   s_dispatch_operand },
+    { "vm.chain",               "call",         s_bench_chain,      0 },
+    { "peephole.constants",     "phrase",       s_bench_peephole,   s_peephole_constants },
+    { "peephole.constants.off", "phrase",       s_bench_peephole,   s_peephole_constants | PEEPHOLE_OFF },
+    { "peephole.unloop",        "loop",         s_bench_peephole,   s_peephole_unloop },
+    { "peephole.unloop.off",    "loop",         s_bench_peephole,   s_peephole_unloop | PEEPHOLE_OFF },
+    { "peephole.jumps",         "call",         s_bench_peephole,   s_peephole_jumps },
+    { "peephole.jumps.off",     "call",         s_bench_peephole,   s_peephole_jumps | PEEPHOLE_OFF },
+    { "specialize.sum",         "call",         s_bench_specialize, 0 },
+    { "specialize.sum.off",     "call",         s_bench_specialize, SPECIALIZE_OFF },
+    { "footprint.vm",           "vm",           s_bench_vm_new,     0 },
+    { "footprint.session",      "session",      s_bench_repl_fork,  0 },
+    { "pipe.send_recv.10",      "value",        s_bench_send_recv,  10 },
+    { "pipe.send_recv.1000",    "value",        s_bench_send_recv,  1000 },
+    { "pipe.send_recv.100000",  "value",        s_bench_send_recv,  100000 },
+    { "pipe.pull.10",           "value",        s_bench_pull,       10 },
+    { "pipe.pull.1000",         "value",        s_bench_pull,       1000 },
+    { "pipe.pull.100000",       "value",        s_bench_pull,       100000 },
+    { "pipe.paste.10",          "value",        s_bench_paste,      10 },
+    { "pipe.paste.1000",        "value",        s_bench_paste,      1000 },
+    { "pipe.paste.100000",      "value",        s_bench_paste,      100000 },
+    { "pipe.encode.10",         "value",        s_bench_encode,     10 },
+    { "pipe.encode.1000",       "value",        s_bench_encode,     1000 },
+    { "pipe.encode.100000",     "value",        s_bench_encode,     100000 },
+    { "script.loop",            "script",       s_bench_script,     0 },
+    { "script.count",           "script",       s_bench_script,     1 },
+    { "script.nested",          "script",       s_bench_script,     2 },
+    { "script.function",        "script",       s_bench_script,     3 },
+    { "script.strings",         "script",       s_bench_script,     4 },
+    { "script.menu",            "script",       s_bench_script,     5 },
+    { "run.loop",               "script",       s_bench_run,        0 },
+    { "run.count",              "script",       s_bench_run,        1 },
+    { "run.nested",             "script",       s_bench_run,        2 },
+    { "run.function",           "script",       s_bench_run,        3 },
+    { "run.strings",            "script",       s_bench_run,        4 },
+    { "run.menu",               "script",       s_bench_run,        5 },
+    { NULL }
+};
+
+
+//  ---------------------------------------------------------------------------
+//  Run one benchmark: find a number of loops that takes at least the minimum
+//  time, run that a few times to warm up caches and CPU clocks, then time
+//  it several times over. We report the median, which is steadier than the
+//  mean on a busy machine, and a 95% confidence interval for the mean,
+//  which we use to compare against a baseline.
+
+typedef struct {
+    size_t loops;                   //  Loops per repeat
+    size_t ops;                     //  Operations per repeat
+    double ns_min;                  //  Fastest repeat, per operation
+    double ns_median;               //  Median repeat, per operation
+    double ns_max;                  //  Slowest repeat, per operation
+    double ns_mean;                 //  Mean of repeats, per operation
+    double ci_low;                  //  95% confidence interval for mean
+    double ci_high;
+    double cycles;                  //  Lexer FSM cycles per operation
+    double heap;                    //  Heap bytes held per operation
+} s_result_t;
+
+static int
+s_compare_doubles (const void *item1, const void *item2)
+{
+    double value1 = *(const double *) item1;
+    double value2 = *(const double *) item2;
+    return (value1 > value2) - (value1 < value2);
+}
+
+//  Two-sided 95% Student t values, for 1 to 30 degrees of freedom
+static double
+s_t_value [] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static void
+s_measure (s_bench_t *bench, uint64_t min_nanos, size_t warmups, size_t repeats,
+           s_result_t *result)
+{
+    s_run_t run = { 1, bench->param, 0, 0, 0, 0 };
+    while (true) {
+        bench->fn (&run);
+        uint64_t elapsed = run.elapsed;
+        if (elapsed >= min_nanos || run.loops >= (size_t) 1 << 40)
+            break;
+        //  Aim a little over the minimum, and at most 100 times more loops
+        size_t loops = elapsed? (size_t) (run.loops * 1.2 * min_nanos / elapsed): run.loops * 100;
+        if (loops > run.loops * 100)
+            loops = run.loops * 100;
+        run.loops = loops > run.loops? loops: run.loops + 1;
+    }
+    size_t warmup;
+    for (warmup = 0; warmup < warmups; warmup++)
+        bench->fn (&run);
+
+    double *samples = (double *) zmalloc (repeats * sizeof (double));
+    assert (samples);
+    double total = 0;
+    size_t repeat;
+    for (repeat = 0; repeat < repeats; repeat++) {
+        run.cycles = 0;
+        size_t ops = bench->fn (&run);
+        samples [repeat] = ops? (double) run.elapsed / ops: 0;
+        total += samples [repeat];
+        result->ops = ops;
+        result->cycles = ops? (double) run.cycles / ops: 0;
+        result->heap = run.heap;
+    }
+    result->ns_mean = total / repeats;
+    double variance = 0;
+    for (repeat = 0; repeat < repeats; repeat++)
+        variance += (samples [repeat] - result->ns_mean) * (samples [repeat] - result->ns_mean);
+    double margin = 0;
+    if (repeats > 1) {
+        variance /= repeats - 1;
+        double t_value = repeats - 1 <= 30? s_t_value [repeats - 2]: 1.96;
+        margin = t_value * sqrt (variance / repeats);
+    }
+    result->ci_low = result->ns_mean - margin;
+    result->ci_high = result->ns_mean + margin;
+
+    qsort (samples, repeats, sizeof (double), s_compare_doubles);
+    result->loops = run.loops;
+    result->ns_min = samples [0];
+    result->ns_median = samples [repeats / 2];
+    result->ns_max = samples [repeats - 1];
+    free (samples);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Baselines are JSON files that zs_bench wrote earlier. We only read our
+//  own format, which puts each benchmark on one line, so we don't need a
+//  real JSON parser.
+
+typedef struct {
+    char *name;
+    double ns_mean;
+    double ci_low;
+    double ci_high;
+} s_baseline_t;
+
+//  Return numeric value of "key": in line, or -1 if not found
+static double
+s_json_number (const char *line, const char *key)
+{
+    char *pattern = zsys_sprintf ("\"%s\": ", key);
+    const char *found = strstr (line, pattern);
+    double value = found? atof (found + strlen (pattern)): -1;
+    zstr_free (&pattern);
+    return value;
+}
+
+//  Load baseline results into a list; returns NULL if the file can't be read
+static zlistx_t *
+s_baseline_load (const char *filename)
+{
+    FILE *file = fopen (filename, "r");
+    if (!file)
+        return NULL;
+    zlistx_t *baselines = zlistx_new ();
+    char line [1024];
+    while (fgets (line, sizeof (line), file)) {
+        const char *name = strstr (line, "{\"name\": \"");
+        if (!name)
+            continue;
+        name += strlen ("{\"name\": \"");
+        const char *quote = strchr (name, '"');
+        if (!quote)
+            continue;
+        s_baseline_t *baseline = (s_baseline_t *) zmalloc (sizeof (s_baseline_t));
+        assert (baseline);
+        baseline->name = (char *) zmalloc (quote - name + 1);
+        memcpy (baseline->name, name, quote - name);
+        baseline->ns_mean = s_json_number (line, "ns_mean");
+        baseline->ci_low = s_json_number (line, "ci_low");
+        baseline->ci_high = s_json_number (line, "ci_high");
+        zlistx_add_end (baselines, baseline);
+    }
+    fclose (file);
+    return baselines;
+}
+
+static s_baseline_t *
+s_baseline_lookup (zlistx_t *baselines, const char *name)
+{
+    s_baseline_t *baseline = (s_baseline_t *) zlistx_first (baselines);
+    while (baseline) {
+        if (streq (baseline->name, name))
+            return baseline;
+        baseline = (s_baseline_t *) zlistx_next (baselines);
+    }
+    return NULL;
+}
+
+static void
+s_baseline_destroy (zlistx_t **baselines_p)
+{
+    zlistx_t *baselines = *baselines_p;
+    if (baselines) {
+        s_baseline_t *baseline = (s_baseline_t *) zlistx_first (baselines);
+        while (baseline) {
+            free (baseline->name);
+            free (baseline);
+            baseline = (s_baseline_t *) zlistx_next (baselines);
+        }
+        zlistx_destroy (baselines_p);
+    }
+}
+
+//  Return true if the result is a regression from the baseline: it must
+//  be slower by more than the threshold, and the confidence intervals must
+//  not overlap, so that noise alone does not fail the gate
+static bool
+s_regressed (s_result_t *result, s_baseline_t *baseline, double threshold)
+{
+    if (baseline->ns_mean <= 0)
+        return false;           //  Old baseline without statistics
+    return result->ns_mean > baseline->ns_mean * (1 + threshold)
+        && result->ci_low > baseline->ci_high;
+}
+
+
+//  Pin the process to one CPU, so the scheduler does not move us between
+//  cores with cold caches or different clock speeds. Returns the CPU, or
+//  -1 if we could not pin.
+static int
+s_pin_cpu (int cpu)
+{
+#if defined (__linux__)
+    if (cpu < 0)
+        cpu = sched_getcpu ();
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO (&cpus);
+        CPU_SET (cpu, &cpus);
+        if (sched_setaffinity (0, sizeof (cpus), &cpus) == 0)
+            return cpu;
+    }
+#endif
+    return -1;
+}
+
+
+int
+main (int argc, char *argv [])
+{
+    bool verbose = false;
+    uint64_t min_nanos = 100 * 1000000;
+    size_t warmups = 1;
+    size_t repeats = 10;
+    const char *filter = NULL;
+    const char *filename = NULL;
+    const char *compare = NULL;
+    double threshold = 0.05;
+    int cpu = -1;
+
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "-v"))
+            verbose = true;
+        else
+        if (streq (argv [argn], "-t") && argn + 1 < argc)
+            min_nanos = (uint64_t) atoll (argv [++argn]) * 1000000;
+        else
+        if (streq (argv [argn], "-w") && argn + 1 < argc)
+            warmups = (size_t) atoll (argv [++argn]);
+        else
+        if (streq (argv [argn], "-r") && argn + 1 < argc)
+            repeats = (size_t) atoll (argv [++argn]);
+        else
+        if (streq (argv [argn], "-o") && argn + 1 < argc)
+            filename = argv [++argn];
+        else
+        if (streq (argv [argn], "--compare") && argn + 1 < argc)
+            compare = argv [++argn];
+        else
+        if (streq (argv [argn], "--threshold") && argn + 1 < argc)
+            threshold = atof (argv [++argn]) / 100;
+        else
+        if (streq (argv [argn], "--cpu") && argn + 1 < argc)
+            cpu = atoi (argv [++argn]);
+        else
+        if (*argv [argn] != '-')
+            filter = argv [argn];
+        else {
+            printf ("syntax: zs_bench [options] [filter]\n");
+            printf ("    -v                print results as they come, to stderr\n");
+            printf ("    -t msecs          minimum time for each repeat (100)\n");
+            printf ("    -w warmups        untimed runs before timing (1)\n");
+            printf ("    -r repeats        number of timed repeats (10)\n");
+            printf ("    -o file           write JSON to file, not stdout\n");
+            printf ("    --compare file    fail if slower than this baseline\n");
+            printf ("    --threshold pct   allowed slowdown, in percent (5)\n");
+            printf ("    --cpu n           pin to this CPU (default: current)\n");
+            printf ("    filter            only run benchmarks whose name contains this\n");
+            return 1;
+        }
+    }
+    if (repeats == 0)
+        repeats = 1;
+
+    zlistx_t *baselines = NULL;
+    if (compare) {
+        baselines = s_baseline_load (compare);
+        if (!baselines) {
+            fprintf (stderr, "E: can't read baseline '%s'\n", compare);
+            return 1;
+        }
+    }
+    FILE *file = filename? fopen (filename, "w"): stdout;
+    if (!file) {
+        fprintf (stderr, "E: can't open '%s' for writing\n", filename);
+        s_baseline_destroy (&baselines);
+        return 1;
+    }
+    cpu = s_pin_cpu (cpu);
+    if (verbose && cpu < 0)
+        fprintf (stderr, "W: could not pin to a CPU, results may be noisy\n");
+
+    fprintf (file, "{\n  \"version\": \"%d.%d.%d\",\n",
+             ZS_VERSION_MAJOR, ZS_VERSION_MINOR, ZS_VERSION_PATCH);
+    fprintf (file, "  \"min_msecs\": %" PRIu64 ",\n  \"warmups\": %zu,\n"
+             "  \"repeats\": %zu,\n  \"cpu\": %d,\n",
+             min_nanos / 1000000, warmups, repeats, cpu);
+    fprintf (file, "  \"benchmarks\": [");
+
+    size_t count = 0;
+    size_t regressions = 0;
+    s_bench_t *bench;
+    for (bench = s_benchmarks; bench->name; bench++) {
+        if (filter && !strstr (bench->name, filter))
+            continue;
+        s_result_t result = { 0 };
+        s_measure (bench, min_nanos, warmups, repeats, &result);
+        double ops_per_sec = result.ns_median > 0? 1e9 / result.ns_median: 0;
+        fprintf (file, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %zu, "
+                 "\"ns_per_op\": %.3f, \"ns_min\": %.3f, \"ns_max\": %.3f, "
+                 "\"ns_mean\": %.3f, \"ci_low\": %.3f, \"ci_high\": %.3f, "
+                 "\"ops_per_sec\": %.0f",
+                 count++? ",": "", bench->name, bench->unit, result.ops,
+                 result.ns_median, result.ns_min, result.ns_max,
+                 result.ns_mean, result.ci_low, result.ci_high, ops_per_sec);
+        if (result.cycles > 0)
+            fprintf (file, ", \"cycles_per_op\": %.3f", result.cycles);
+        if (result.heap > 0)
+            fprintf (file, ", \"heap_bytes_per_op\": %.0f", result.heap);
+        fprintf (file, "}");
+        if (verbose)
+            fprintf (stderr, "%-24s %12.1f ns/%-12s %14.0f/sec  +/- %.1f%%\n",
+                     bench->name, result.ns_median, bench->unit, ops_per_sec,
+                     result.ns_mean > 0? 100 * (result.ci_high - result.ns_mean) / result.ns_mean: 0);
+        if (verbose && result.heap > 0)
+            fprintf (stderr, "%-24s %12.0f heap bytes/%s\n", "", result.heap, bench->unit);
+        if (baselines) {
+            s_baseline_t *baseline = s_baseline_lookup (baselines, bench->name);
+            if (baseline && s_regressed (&result, baseline, threshold)) {
+                fprintf (stderr, "E: %s regressed %.1f%%: %.1f ns/%s, was %.1f (%.1f..%.1f)\n",
+                         bench->name, 100 * (result.ns_mean / baseline->ns_mean - 1),
+                         result.ns_mean, bench->unit, baseline->ns_mean,
+                         baseline->ci_low, baseline->ci_high);
+                regressions++;
+            }
+        }
+    }
+    fprintf (file, "\n  ]\n}\n");
+    if (filename)
+        fclose (file);
+    s_baseline_destroy (&baselines);
+    if (regressions) {
+        fprintf (stderr, "E: %zu benchmarks regressed more than %.1f%%\n",
+                 regressions, threshold * 100);
+        return 2;
+    }
+    return 0;
+}
@@ -21,6 +21,8 @@
 #include "../include/zs.h"
 
 //  Internal API
+#include "zs_pool.h"
+#include "zs_trace.h"
 #include "zs_vm.h"
 #include "zs_lex.h"
 
@@ -44,6 +44,9 @@
 
 #include "zs_classes.h"
 #include "zs_lex_fsm.h"         //  Finite state machine engine
+#if defined (__SSE2__)
+#   include <emmintrin.h>
+#endif
 
 //  Structure of our class
 
@@ -52,9 +55,13 @@ struct _zs_lex_t {
     event_t events [256];       //  Map characters to events
     const char *input;          //  Line of text we're parsing
     const char *input_ptr;      //  Next character to process
-    uint token_size;            //  Size of token so far
+    const char *input_end;      //  End of text we're parsing
+    const char *token;          //  Current token, as slice
+    size_t token_size;          //  Size of token so far
     zs_lex_token_t type;        //  Token type
-    char token [1025];          //  Current token, max size 1K
+    char *buffer;               //  Token copied out of input, if needed
+    size_t buffer_max;          //  Allocated size of buffer
+    bool copied;                //  Token is being built in buffer
     char current;               //  Current character
 };
 
@@ -65,6 +72,152 @@ s_set_events (zs_lex_t *self, const char *chars, event_t event)
         self->events [(uint) *chars++] = event;
 }
 
+//  Runs of characters that the lexer consumes in one FSM cycle, rather
+//  than one cycle per character
+
+typedef enum {
+    s_run_whitespace,           //  Spaces, tabs, and newlines
+    s_run_function,             //  Letters, digits, and / * ^ _ -
+    s_run_number,               //  Letters, digits, and + -
+    s_run_string,               //  Anything up to > or end of input
+    s_run_comment               //  Anything up to newline or end of input
+} s_run_t;
+
+//  Return true if the character continues the run; this must agree with
+//  the character events we set in zs_lex_new.
+static inline bool
+s_in_run (zs_lex_t *self, char current, s_run_t run)
+{
+    event_t event = self->events [(byte) current];
+    switch (run) {
+        case s_run_whitespace:
+            return event == whitespace_event || event == newline_event;
+        case s_run_function:
+            return event == letter_event || event == digit_event
+                || event == hyphen_event || event == usable_event;
+        case s_run_number:
+            return event == letter_event || event == digit_event
+                || event == hyphen_event || event == plus_event;
+        case s_run_string:
+            return current && current != '>';
+        case s_run_comment:
+            return current && current != '\n';
+    }
+    return false;
+}
+
+#if defined (__SSE2__)
+//  Return bitmask of the bytes in the block that are within lo..hi. SSE2
+//  only has signed compares, so we first move the range down to -128.
+static inline __m128i
+s_in_range (__m128i block, char lo, char hi)
+{
+    __m128i moved = _mm_add_epi8 (block, _mm_set1_epi8 ((char) (0x80 - lo)));
+    return _mm_cmplt_epi8 (moved, _mm_set1_epi8 ((char) (0x80 + hi - lo + 1)));
+}
+
+//  Return bitmask of the bytes in the block that continue the run
+static inline uint
+s_block_in_run (__m128i block, s_run_t run)
+{
+#   define S_IS(c) _mm_cmpeq_epi8 (block, _mm_set1_epi8 (c))
+    __m128i in_run;
+    if (run == s_run_string || run == s_run_comment) {
+        __m128i stop = _mm_or_si128 (S_IS (0), S_IS (run == s_run_string? '>': '\n'));
+        return ~_mm_movemask_epi8 (stop) & 0xFFFF;
+    }
+    if (run == s_run_whitespace)
+        in_run = _mm_or_si128 (_mm_or_si128 (S_IS (' '), S_IS ('\t')), S_IS ('\n'));
+    else {
+        in_run = _mm_or_si128 (
+            s_in_range (_mm_or_si128 (block, _mm_set1_epi8 (0x20)), 'a', 'z'),
+            s_in_range (block, '0', '9'));
+        in_run = _mm_or_si128 (in_run, S_IS ('-'));
+        if (run == s_run_function)
+            in_run = _mm_or_si128 (in_run, _mm_or_si128 (
+                _mm_or_si128 (S_IS ('/'), S_IS ('*')),
+                _mm_or_si128 (S_IS ('^'), S_IS ('_'))));
+        else
+            in_run = _mm_or_si128 (in_run, S_IS ('+'));
+    }
+    return _mm_movemask_epi8 (in_run);
+#   undef S_IS
+}
+#endif
+
+//  Return length of the run starting at the input pointer. With SSE2 we
+//  check 16 bytes at once. We only do aligned loads, which never cross a
+//  page boundary, and never load a block that starts after the end of
+//  input, so reading past the end is harmless; the address and thread
+//  sanitizers don't know this, so we tell them not to look.
+#if defined (__GNUC__)
+__attribute__ ((no_sanitize_address, no_sanitize_thread))
+#endif
+static inline size_t
+s_scan_run (zs_lex_t *self, s_run_t run)
+{
+    const char *start = self->input_ptr;
+    const char *end = self->input_end;
+    //  Most runs in real scripts are short, so check the first character
+    //  before we do any heavier work
+    if (start == end || !s_in_run (self, *start, run))
+        return 0;
+#if defined (__SSE2__)
+    size_t offset = (uintptr_t) start & 15;
+    const __m128i *block = (const __m128i *) (start - offset);
+    //  Ignore the bytes before the start of the run
+    uint stops = ~(s_block_in_run (_mm_load_si128 (block), run) | ((1 << offset) - 1)) & 0xFFFF;
+    while (!stops && (const char *) (block + 1) < end)
+        stops = ~s_block_in_run (_mm_load_si128 (++block), run) & 0xFFFF;
+    const char *stop = stops? (const char *) block + __builtin_ctz (stops): end;
+    return (stop < end? stop: end) - start;
+#else
+    const char *stop = start;
+    while (stop < end && s_in_run (self, *stop, run))
+        stop++;
+    return stop - start;
+#endif
+}
+
+//  Make sure the buffer can hold at least size bytes
+static void
+s_buffer_reserve (zs_lex_t *self, size_t size)
+{
+    if (size > self->buffer_max) {
+        while (size > self->buffer_max)
+            self->buffer_max *= 2;
+        self->buffer = (char *) realloc (self->buffer, self->buffer_max);
+        assert (self->buffer);
+    }
+}
+
+//  Add characters to the current token. Tokens are normally slices of the
+//  input, and the characters we add are the next ones in the input. Only
+//  strings that continue over several inputs get copied into our buffer.
+static inline void
+s_store (zs_lex_t *self, const char *start, size_t size)
+{
+    if (self->copied) {
+        s_buffer_reserve (self, self->token_size + size + 1);
+        memcpy (self->buffer + self->token_size, start, size);
+    }
+    else
+    if (self->token_size == 0)
+        self->token = start;
+    else
+        assert (start == self->token + self->token_size);
+    self->token_size += size;
+}
+
+//  Store the run starting at the input pointer, and skip past it
+static inline void
+s_store_run (zs_lex_t *self, s_run_t run)
+{
+    size_t size = s_scan_run (self, run);
+    s_store (self, self->input_ptr, size);
+    self->input_ptr += size;
+}
+
 //  ---------------------------------------------------------------------------
 //  Create a new zs_lex, return the reference if successful, or NULL
 //  if construction failed due to lack of available memory.
@@ -75,6 +228,12 @@ zs_lex_new (void)
     zs_lex_t *self = (zs_lex_t *) zmalloc (sizeof (zs_lex_t));
     if (self) {
         self->fsm = fsm_new (self);
+        self->buffer_max = 256;
+        self->buffer = (char *) zmalloc (self->buffer_max);
+        if (!self->fsm || !self->buffer) {
+            zs_lex_destroy (&self);
+            return NULL;
+        }
         uint char_nbr;
         self->events [0] = finished_event;
         for (char_nbr = 1; char_nbr < 256; char_nbr++)
@@ -122,6 +281,7 @@ zs_lex_destroy (zs_lex_t **self_p)
     if (*self_p) {
         zs_lex_t *self = *self_p;
         fsm_destroy (&self->fsm);
+        free (self->buffer);
         free (self);
         *self_p = NULL;
     }
@@ -143,9 +303,21 @@ zs_lex_set_verbose (zs_lex_t *self, bool verbose)
 
 zs_lex_token_t
 zs_lex_first (zs_lex_t *self, const char *input)
+{
+    return zs_lex_first_slice (self, input, strlen (input));
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Start parsing a buffer of the given size, which does not need to be
+//  null-terminated; return type of first token
+
+zs_lex_token_t
+zs_lex_first_slice (zs_lex_t *self, const char *input, size_t size)
 {
     self->input = input;
     self->input_ptr = self->input;
+    self->input_end = self->input + size;
     return zs_lex_next (self);
 }
 
@@ -163,12 +335,37 @@ zs_lex_next (zs_lex_t *self)
 
 
 //  ---------------------------------------------------------------------------
-//  Return actual token value, if any
+//  Return actual token value, if any. This copies the token out of the
+//  input; use zs_lex_slice to avoid the copy. The value stays valid until
+//  the next call to the lexer.
 
 const char *
 zs_lex_value (zs_lex_t *self)
 {
-    return self->token;
+    if (!self->copied) {
+        s_buffer_reserve (self, self->token_size + 1);
+        if (self->token_size)
+            memcpy (self->buffer, self->token, self->token_size);
+    }
+    self->buffer [self->token_size] = 0;
+    return self->buffer;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return actual token value, if any, as a slice of the input, and set
+//  size_p to its size. The slice is not null-terminated. It stays valid as
+//  long as the input does, and until the next call to the lexer.
+
+const char *
+zs_lex_slice (zs_lex_t *self, size_t *size_p)
+{
+    assert (size_p);
+    *size_p = self->token_size;
+    if (self->copied)
+        return self->buffer;
+    else
+        return self->token_size? self->token: "";
 }
 
 
@@ -193,6 +390,7 @@ static void
 start_new_token (zs_lex_t *self)
 {
     self->token_size = 0;
+    self->copied = false;
     self->type = zs_lex_null;
 }
 
@@ -204,8 +402,63 @@ start_new_token (zs_lex_t *self)
 static void
 store_the_character (zs_lex_t *self)
 {
-    self->token [self->token_size++] = self->current;
-    self->token [self->token_size] = 0;
+    assert (self->input_ptr [-1] == self->current);
+    s_store (self, self->input_ptr - 1, 1);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  store_function_characters
+//
+
+static void
+store_function_characters (zs_lex_t *self)
+{
+    s_store_run (self, s_run_function);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  store_number_characters
+//
+
+static void
+store_number_characters (zs_lex_t *self)
+{
+    s_store_run (self, s_run_number);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  store_string_characters
+//
+
+static void
+store_string_characters (zs_lex_t *self)
+{
+    s_store_run (self, s_run_string);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  skip_whitespace_characters
+//
+
+static void
+skip_whitespace_characters (zs_lex_t *self)
+{
+    self->input_ptr += s_scan_run (self, s_run_whitespace);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  skip_comment_characters
+//
+
+static void
+skip_comment_characters (zs_lex_t *self)
+{
+    self->input_ptr += s_scan_run (self, s_run_comment);
 }
 
 
@@ -216,7 +469,7 @@ store_the_character (zs_lex_t *self)
 static void
 parse_next_character (zs_lex_t *self)
 {
-    self->current = *self->input_ptr;
+    self->current = self->input_ptr < self->input_end? *self->input_ptr: 0;
     if (self->current)
         self->input_ptr++;      //  Don't advance past end of input
     fsm_set_next_event (self->fsm, self->events [(uint) self->current]);
@@ -243,8 +496,9 @@ push_back_to_previous (zs_lex_t *self)
 static void
 store_comma_character (zs_lex_t *self)
 {
-    self->token [self->token_size++] = ',';
-    self->token [self->token_size] = 0;
+    //  The comma comes just before the current character
+    assert (self->input_ptr [-2] == ',');
+    s_store (self, self->input_ptr - 2, 1);
 }
 
 
@@ -255,8 +509,9 @@ store_comma_character (zs_lex_t *self)
 static void
 store_period_character (zs_lex_t *self)
 {
-    self->token [self->token_size++] = '.';
-    self->token [self->token_size] = 0;
+    //  The period comes just before the current character
+    assert (self->input_ptr [-2] == '.');
+    s_store (self, self->input_ptr - 2, 1);
 }
 
 
@@ -267,8 +522,15 @@ store_period_character (zs_lex_t *self)
 static void
 store_newline_character (zs_lex_t *self)
 {
-    self->token [self->token_size++] = '\n';
-    self->token [self->token_size] = 0;
+    //  The string continues in the next input, so the token can no longer
+    //  be a slice of the input
+    if (!self->copied) {
+        s_buffer_reserve (self, self->token_size + 1);
+        if (self->token_size)
+            memcpy (self->buffer, self->token, self->token_size);
+        self->copied = true;
+    }
+    s_store (self, "\n", 1);
 }
 
 
@@ -479,8 +741,40 @@ zs_lex_test (bool verbose)
 
     assert (zs_lex_first (lex, "<Here is a long string") == zs_lex_null);
     assert (zs_lex_first (lex, " which continues over two lines>") == zs_lex_string);
+    assert (streq (zs_lex_value (lex), "Here is a long string\n which continues over two lines"));
     assert (zs_lex_next (lex) == zs_lex_null);
 
+    //  Tokens are slices of the input, of any size
+    const char *text = "sum (1234, 5) <Hello, World>";
+    size_t size;
+    assert (zs_lex_first (lex, text) == zs_lex_fn_nested);
+    assert (zs_lex_slice (lex, &size) == text && size == 3);
+    assert (zs_lex_next (lex) == zs_lex_number);
+    assert (zs_lex_slice (lex, &size) == text + 5 && size == 4);
+    assert (zs_lex_next (lex) == zs_lex_phrase);
+    assert (zs_lex_next (lex) == zs_lex_number);
+    assert (zs_lex_next (lex) == zs_lex_fn_close);
+    assert (zs_lex_next (lex) == zs_lex_string);
+    assert (zs_lex_slice (lex, &size) == text + 15 && size == 12);
+    assert (zs_lex_next (lex) == zs_lex_null);
+
+    //  Input need not be null-terminated
+    assert (zs_lex_first_slice (lex, "sum (1 23) junk", 8) == zs_lex_fn_nested);
+    assert (zs_lex_next (lex) == zs_lex_number);
+    assert (zs_lex_next (lex) == zs_lex_number);
+    assert (zs_lex_slice (lex, &size) && size == 1);
+    assert (zs_lex_next (lex) == zs_lex_null);
+
+    char *long_string = (char *) zmalloc (100002);
+    long_string [0] = '<';
+    memset (long_string + 1, 'x', 100000);
+    long_string [100000] = '>';
+    assert (zs_lex_first (lex, long_string) == zs_lex_string);
+    assert (zs_lex_slice (lex, &size) == long_string + 1 && size == 99999);
+    assert (strlen (zs_lex_value (lex)) == 99999);
+    assert (zs_lex_next (lex) == zs_lex_null);
+    free (long_string);
+
     //  Calling inline functions
     assert (zs_lex_first (lex, "something(22.7e2)") == zs_lex_fn_nested);
     assert (streq (zs_lex_value (lex), "something"));
@@ -581,6 +875,28 @@ zs_lex_test (bool verbose)
     assert (zs_lex_next (lex) == zs_lex_null);
     assert (zs_lex_first (lex, "1?2") == zs_lex_invalid);
 
+    //  Long runs of characters are scanned in one go, so check that runs
+    //  end in the right place, whatever their alignment
+    char *input = strdup ("   \t\n  a-long_function/name*^2 123456789012345678e-5+"
+                          "  <a string, of some (length) that's [long]>   # comment\n"
+                          "x # comment to the end");
+    size_t offset;
+    for (offset = 0; offset < 32; offset++) {
+        char *shifted = (char *) zmalloc (offset + strlen (input) + 1);
+        strcpy (shifted + offset, input);
+        assert (zs_lex_first (lex, shifted + offset) == zs_lex_fn_inline);
+        assert (streq (zs_lex_value (lex), "a-long_function/name*^2"));
+        assert (zs_lex_next (lex) == zs_lex_number);
+        assert (streq (zs_lex_value (lex), "123456789012345678e-5+"));
+        assert (zs_lex_next (lex) == zs_lex_string);
+        assert (streq (zs_lex_value (lex), "a string, of some (length) that's [long]"));
+        assert (zs_lex_next (lex) == zs_lex_fn_inline);
+        assert (streq (zs_lex_value (lex), "x"));
+        assert (zs_lex_next (lex) == zs_lex_null);
+        free (shifted);
+    }
+    free (input);
+
     if (verbose)
         printf ("%ld cycles done\n", (long) zs_lex_cycles (lex));
     zs_lex_destroy (&lex);
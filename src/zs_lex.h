@@ -58,14 +58,27 @@ void
 zs_lex_token_t
     zs_lex_first (zs_lex_t *self, const char *input);
 
+//  Start parsing a buffer of the given size, which does not need to be
+//  null-terminated; return type of first token
+zs_lex_token_t
+    zs_lex_first_slice (zs_lex_t *self, const char *input, size_t size);
+
 //  Continue parsing buffer, return type of next token
 zs_lex_token_t
     zs_lex_next (zs_lex_t *self);
 
-//  Return actual token value, if any
+//  Return actual token value, if any. This copies the token out of the
+//  input; use zs_lex_slice to avoid the copy. The value stays valid until
+//  the next call to the lexer.
 const char *
     zs_lex_value (zs_lex_t *self);
 
+//  Return actual token value, if any, as a slice of the input, and set
+//  size_p to its size. The slice is not null-terminated. It stays valid as
+//  long as the input does, and until the next call to the lexer.
+const char *
+    zs_lex_slice (zs_lex_t *self, size_t *size_p);
+
 //  Return position of last processed character in text
 uint
     zs_lex_offset (zs_lex_t *self);
@@ -108,7 +108,9 @@ s_event_name [] = {
 //  Action prototypes
 static void start_new_token (zs_lex_t *self);
 static void store_the_character (zs_lex_t *self);
+static void store_function_characters (zs_lex_t *self);
 static void parse_next_character (zs_lex_t *self);
+static void store_number_characters (zs_lex_t *self);
 static void have_close_list_token (zs_lex_t *self);
 static void have_start_menu_token (zs_lex_t *self);
 static void have_end_menu_token (zs_lex_t *self);
@@ -127,7 +129,49 @@ static void store_comma_character (zs_lex_t *self);
 static void store_period_character (zs_lex_t *self);
 static void have_string_token (zs_lex_t *self);
 static void store_newline_character (zs_lex_t *self);
+static void store_string_characters (zs_lex_t *self);
+static void skip_comment_characters (zs_lex_t *self);
 static void have_invalid_token (zs_lex_t *self);
+static void skip_whitespace_characters (zs_lex_t *self);
+
+//  Transition for each state and event; this is the case in fsm_execute
+//  that runs the action list, or 0 if the state does not handle the event
+static byte
+s_transition [][24] = {
+    { 0 },
+    //  expecting_token
+    { 0, 1, 2, 2, 3, 1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 14, 15, 15, 15, 15, 15, 16 },
+    //  reading_function
+    { 0, 17, 17, 15, 17, 17, 15, 18, 18, 18, 18, 18, 18, 18, 18, 19, 20, 20, 21, 22, 15, 15, 15, 16 },
+    //  after_function
+    { 0, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 19, 18, 18, 21, 22, 18, 18, 18, 18 },
+    //  after_function_colon
+    { 0, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 14, 14, 15, 23, 15, 15, 15, 16 },
+    //  after_unary_sign
+    { 0, 24, 24, 24, 25, 17, 15, 18, 18, 18, 18, 18, 18, 18, 18, 19, 20, 20, 21, 22, 26, 15, 15, 16 },
+    //  after_period
+    { 0, 27, 27, 27, 25, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27 },
+    //  reading_number
+    { 0, 28, 28, 28, 28, 15, 15, 29, 29, 29, 29, 15, 15, 30, 31, 32, 32, 32, 15, 15, 26, 15, 15, 16 },
+    //  after_number_comma
+    { 0, 33, 33, 33, 34, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33 },
+    //  after_number_period
+    { 0, 33, 33, 33, 35, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33 },
+    //  reading_string
+    { 0, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 37, 36, 36, 36, 36, 36, 38, 36, 36 },
+    //  reading_comment
+    { 0, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 40, 39, 41, 39, 39, 39, 39, 39, 39 },
+    //  defaults
+    { 0, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 14, 14, 15, 15, 15, 15, 15, 16 }
+};
+
+//  Define FSM_QUIET to build the state machine without animation, so it
+//  does not test the animate flag in every cycle
+#if defined (FSM_QUIET)
+#   define fsm_animating(self)  false
+#else
+#   define fsm_animating(self)  ((self)->animate)
+#endif
 
 //  This is the context block for a FSM thread; use the setter
 //  methods to set the FSM properties.
@@ -218,1515 +262,480 @@ fsm_execute (fsm_t *self)
         self->event = self->next_event;
         self->next_event = NULL_event;
         self->exception = NULL_event;
-        if (self->animate) {
+        if (fsm_animating (self)) {
             zsys_debug ("zs_lex: %s:", s_state_name [self->state]);
             zsys_debug ("zs_lex:            %s", s_event_name [self->event]);
         }
-        if (self->state == expecting_token_state) {
-            if (self->event == letter_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+        switch (s_transition [self->state][self->event]) {
+            case 1:
+                //  expecting_token: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ start_new_token");
+                start_new_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_function_characters");
+                store_function_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_function_state;
-            }
-            else
-            if (self->event == hyphen_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_unary_sign_state;
-            }
-            else
-            if (self->event == plus_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 2:
+                //  expecting_token: hyphen
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ start_new_token");
+                start_new_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_unary_sign_state;
-            }
-            else
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 3:
+                //  expecting_token: digit
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ start_new_token");
+                start_new_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_number_characters");
+                store_number_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_number_state;
-            }
-            else
-            if (self->event == usable_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_function_state;
-            }
-            else
-            if (self->event == open_quote_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 4:
+                //  expecting_token: open_quote
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ start_new_token");
+                start_new_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_string_state;
-            }
-            else
-            if (self->event == close_paren_event) {
-                if (!self->exception) {
-                    //  have_close_list_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_close_list_token");
-                    have_close_list_token (self->parent);
-                }
-            }
-            else
-            if (self->event == open_square_event) {
-                if (!self->exception) {
-                    //  have_start_menu_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_start_menu_token");
-                    have_start_menu_token (self->parent);
-                }
-            }
-            else
-            if (self->event == close_square_event) {
-                if (!self->exception) {
-                    //  have_end_menu_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_end_menu_token");
-                    have_end_menu_token (self->parent);
-                }
-            }
-            else
-            if (self->event == vertical_bar_event) {
-                if (!self->exception) {
-                    //  have_choice_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_choice_token");
-                    have_choice_token (self->parent);
-                }
-            }
-            else
-            if (self->event == open_curly_event) {
-                if (!self->exception) {
-                    //  have_start_loop_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_start_loop_token");
-                    have_start_loop_token (self->parent);
-                }
-            }
-            else
-            if (self->event == close_curly_event) {
-                if (!self->exception) {
-                    //  have_end_loop_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_end_loop_token");
-                    have_end_loop_token (self->parent);
-                }
-            }
-            else
-            if (self->event == comma_event) {
-                if (!self->exception) {
-                    //  have_phrase_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_phrase_token");
-                    have_phrase_token (self->parent);
-                }
-            }
-            else
-            if (self->event == period_event) {
-                if (!self->exception) {
-                    //  start_new_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ start_new_token");
-                    start_new_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 5:
+                //  expecting_token: close_paren
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_close_list_token");
+                have_close_list_token (self->parent);
+                break;
+            case 6:
+                //  expecting_token: open_square
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_start_menu_token");
+                have_start_menu_token (self->parent);
+                break;
+            case 7:
+                //  expecting_token: close_square
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_end_menu_token");
+                have_end_menu_token (self->parent);
+                break;
+            case 8:
+                //  expecting_token: vertical_bar
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_choice_token");
+                have_choice_token (self->parent);
+                break;
+            case 9:
+                //  expecting_token: open_curly
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_start_loop_token");
+                have_start_loop_token (self->parent);
+                break;
+            case 10:
+                //  expecting_token: close_curly
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_end_loop_token");
+                have_end_loop_token (self->parent);
+                break;
+            case 11:
+                //  expecting_token: comma
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_phrase_token");
+                have_phrase_token (self->parent);
+                break;
+            case 12:
+                //  expecting_token: period
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ start_new_token");
+                start_new_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_period_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_null_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_null_token");
-                    have_null_token (self->parent);
-                }
-            }
-            else
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 13:
+                //  expecting_token: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_null_token");
+                have_null_token (self->parent);
+                break;
+            case 14:
+                //  expecting_token: whitespace
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ skip_whitespace_characters");
+                skip_whitespace_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                break;
+            case 15:
+                //  expecting_token: colon
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_invalid_token");
+                have_invalid_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 16:
+                //  expecting_token: comment
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_comment_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == reading_function_state) {
-            if (self->event == letter_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == hyphen_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == usable_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_function_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 17:
+                //  reading_function: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_function_characters");
+                store_function_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                break;
+            case 18:
+                //  reading_function: close_paren
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_fn_inline_token");
+                have_fn_inline_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ push_back_to_previous");
+                push_back_to_previous (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 19:
+                //  reading_function: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_fn_inline_token");
+                have_fn_inline_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 20:
+                //  reading_function: whitespace
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_function_state;
-            }
-            else
-            if (self->event == colon_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 21:
+                //  reading_function: colon
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_function_colon_state;
-            }
-            else
-            if (self->event == open_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_nested_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_nested_token");
-                    have_fn_nested_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_square_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_square_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == vertical_bar_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_curly_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_curly_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comma_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == period_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_comment_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_function_state) {
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_nested_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_nested_token");
-                    have_fn_nested_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == colon_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_function_colon_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_function_colon_state) {
-            if (self->event == open_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_define_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_define_token");
-                    have_fn_define_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_comment_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_unary_sign_state) {
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_number_state;
-            }
-            else
-            if (self->event == letter_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 22:
+                //  reading_function: open_paren
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_fn_nested_token");
+                have_fn_nested_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 23:
+                //  after_function_colon: open_paren
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_fn_define_token");
+                have_fn_define_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 24:
+                //  after_unary_sign: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_function_state;
-            }
-            else
-            if (self->event == hyphen_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_function_state;
-            }
-            else
-            if (self->event == plus_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_function_state;
-            }
-            else
-            if (self->event == percent_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == usable_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_function_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_function_state;
-            }
-            else
-            if (self->event == colon_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = after_function_colon_state;
-            }
-            else
-            if (self->event == open_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_nested_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_nested_token");
-                    have_fn_nested_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_paren_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_square_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_square_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == vertical_bar_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_curly_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_curly_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comma_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == period_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_fn_inline_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_fn_inline_token");
-                    have_fn_inline_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_comment_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_period_state) {
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 25:
+                //  after_unary_sign: digit
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_number_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_sentence_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_sentence_token");
-                    have_sentence_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == reading_number_state) {
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == letter_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == hyphen_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == plus_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == percent_event) {
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_paren_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == open_square_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == close_square_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == vertical_bar_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comma_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 26:
+                //  after_unary_sign: percent
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_number_token");
+                have_number_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 27:
+                //  after_period: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_sentence_token");
+                have_sentence_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ push_back_to_previous");
+                push_back_to_previous (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 28:
+                //  reading_number: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_number_characters");
+                store_number_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                break;
+            case 29:
+                //  reading_number: close_paren
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_number_token");
+                have_number_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ push_back_to_previous");
+                push_back_to_previous (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 30:
+                //  reading_number: comma
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_number_comma_state;
-            }
-            else
-            if (self->event == period_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 31:
+                //  reading_number: period
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = after_number_period_state;
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_comment_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_number_comma_state) {
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_comma_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_comma_character");
-                    store_comma_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 32:
+                //  reading_number: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_number_token");
+                have_number_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 33:
+                //  after_number_comma: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_number_token");
+                have_number_token (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ push_back_to_previous");
+                push_back_to_previous (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ push_back_to_previous");
+                push_back_to_previous (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 34:
+                //  after_number_comma: digit
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_comma_character");
+                store_comma_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_number_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == after_number_period_state) {
-            if (self->event == digit_event) {
-                if (!self->exception) {
-                    //  store_period_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_period_character");
-                    store_period_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
+                break;
+            case 35:
+                //  after_number_period: digit
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_period_character");
+                store_period_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
                 if (!self->exception)
                     self->state = reading_number_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_number_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_number_token");
-                    have_number_token (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception) {
-                    //  push_back_to_previous
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ push_back_to_previous");
-                    push_back_to_previous (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-        }
-        else
-        if (self->state == reading_string_state) {
-            if (self->event == close_quote_event) {
-                if (!self->exception) {
-                    //  have_string_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_string_token");
-                    have_string_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  store_newline_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_newline_character");
-                    store_newline_character (self->parent);
-                }
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  store_the_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ store_the_character");
-                    store_the_character (self->parent);
-                }
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-        }
-        else
-        if (self->state == reading_comment_state) {
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  have_null_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_null_token");
-                    have_null_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-        }
-        else
-        if (self->state == defaults_state) {
-            if (self->event == other_event) {
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
-            else
-            if (self->event == whitespace_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else
-            if (self->event == comment_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-                if (!self->exception)
-                    self->state = reading_comment_state;
-            }
-            else
-            if (self->event == newline_event) {
-                if (!self->exception) {
-                    //  parse_next_character
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ parse_next_character");
-                    parse_next_character (self->parent);
-                }
-            }
-            else {
-                //  Handle all other events
-                if (!self->exception) {
-                    //  have_invalid_token
-                    if (self->animate)
-                        zsys_debug ("zs_lex:                $ have_invalid_token");
-                    have_invalid_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = expecting_token_state;
-            }
+                break;
+            case 36:
+                //  reading_string: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_the_character");
+                store_the_character (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_string_characters");
+                store_string_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                break;
+            case 37:
+                //  reading_string: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ store_newline_character");
+                store_newline_character (self->parent);
+                break;
+            case 38:
+                //  reading_string: close_quote
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_string_token");
+                have_string_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 39:
+                //  reading_comment: letter
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ skip_comment_characters");
+                skip_comment_characters (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                break;
+            case 40:
+                //  reading_comment: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ have_null_token");
+                have_null_token (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            case 41:
+                //  reading_comment: newline
+                if (fsm_animating (self))
+                    zsys_debug ("zs_lex:                $ parse_next_character");
+                parse_next_character (self->parent);
+                if (!self->exception)
+                    self->state = expecting_token_state;
+                break;
+            default:
+                //  Handle unexpected internal events
+                zsys_warning ("zs_lex: unhandled event %s in %s",
+                    s_event_name [self->event], s_state_name [self->state]);
+                exit (-1);
         }
         //  If we had an exception event, interrupt normal programming
         if (self->exception) {
-            if (self->animate)
+            if (fsm_animating (self))
                 zsys_debug ("zs_lex:                ! %s", s_event_name [self->exception]);
             self->next_event = self->exception;
         }
         else
-        if (self->animate)
+        if (fsm_animating (self))
             zsys_debug ("zs_lex:                > %s", s_state_name [self->state]);
     }
 }
@@ -80,6 +80,18 @@ s_value_string (value_t *self, zs_pipe_t *pipe)
     return "";
 }
 
+//  Send string of known size to pipe; the string need not be terminated
+static void
+s_send_string (zs_pipe_t *self, const char *string, size_t size)
+{
+    value_t *value = (value_t *) zmalloc (sizeof (value_t) + size + 1);
+    value->type = 's';
+    value->string = &value->type + 1;
+    memcpy (value->string, string, size);
+    value->string [size] = 0;
+    zlistx_add_end (self->values, value);
+}
+
 //  ---------------------------------------------------------------------------
 //  Create a new zs_pipe, return the reference if successful, or NULL
 //  if construction failed due to lack of available memory.
@@ -146,11 +158,7 @@ zs_pipe_send_real (zs_pipe_t *self, double real)
 void
 zs_pipe_send_string (zs_pipe_t *self, const char *string)
 {
-    value_t *value = s_value_new (string);
-    value->type = 's';
-    value->string = &value->type + 1;
-    strcpy (value->string, string);
-    zlistx_add_end (self->values, value);
+    s_send_string (self, string, strlen (string));
 }
 
 
@@ -460,6 +468,38 @@ zs_pipe_pull_array (zs_pipe_t *self, zs_pipe_t *source)
 }
 
 
+//  ---------------------------------------------------------------------------
+//  Pulls up to count values, including marks, off the start of the source
+//  pipe and appends them to the pipe, keeping their order. We use this to
+//  split a pipe into chunks, and to join chunks back together.
+
+void
+zs_pipe_pull_count (zs_pipe_t *self, zs_pipe_t *source, size_t count)
+{
+    while (count--) {
+        value_t *value = (value_t *) zlistx_first (source->values);
+        if (!value)
+            break;
+        zlistx_detach_cur (source->values);
+        zlistx_add_end (self->values, value);
+        if (value->type == 'r') {
+            source->nbr_reals--;
+            self->nbr_reals++;
+        }
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of values in the pipe, including marks.
+
+size_t
+zs_pipe_size (zs_pipe_t *self)
+{
+    return zlistx_size (self->values);
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Return pipe contents, as string. Caller must free it when done. Values are
 //  separated by spaces. This empties the pipe.
@@ -470,6 +510,8 @@ zs_pipe_paste (zs_pipe_t *self)
     //  We use an extensible CZMQ chunk
     zchunk_t *chunk = zchunk_new (NULL, 256);
 
+    //  We use the register to format each value, so clear it first
+    s_value_destroy (&self->value);
     while ((self->value = (value_t *) zlistx_detach (self->values, NULL))) {
         const char *string = zs_pipe_string (self);
         if (streq (string, "|"))
@@ -481,6 +523,7 @@ zs_pipe_paste (zs_pipe_t *self)
         }
         s_value_destroy (&self->value);
     }
+    self->nbr_reals = 0;
     size_t result_size = zchunk_size (chunk);
     char *result = (char *) malloc (result_size + 1);
     memcpy (result, (char *) zchunk_data (chunk), result_size);
@@ -490,6 +533,278 @@ zs_pipe_paste (zs_pipe_t *self)
 }
 
 
+//  Wire format helpers; wholes are zigzag encoded so that small negative
+//  numbers stay short, then stored as little-endian base 128 varints.
+
+static void
+s_encode_varint (zchunk_t *chunk, uint64_t number)
+{
+    byte buffer [10];
+    size_t size = 0;
+    while (number > 0x7F) {
+        buffer [size++] = (byte) (number & 0x7F) | 0x80;
+        number >>= 7;
+    }
+    buffer [size++] = (byte) number;
+    zchunk_extend (chunk, buffer, size);
+}
+
+static int
+s_decode_varint (const byte **needle_p, const byte *limit, uint64_t *number_p)
+{
+    const byte *needle = *needle_p;
+    uint64_t number = 0;
+    uint shift = 0;
+    while (needle < limit && shift < 64) {
+        byte octet = *needle++;
+        number |= (uint64_t) (octet & 0x7F) << shift;
+        if ((octet & 0x80) == 0) {
+            *needle_p = needle;
+            *number_p = number;
+            return 0;
+        }
+        shift += 7;
+    }
+    return -1;                  //  Truncated or overlong varint
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return pipe contents, encoded in binary wire format. Caller must destroy
+//  the chunk when done. This empties the pipe. Each value is a type byte
+//  followed by its data: 'w' + zigzag varint, 'r' + 8-byte IEEE 754 double
+//  in network order, 's' + varint length + string bytes, and '|' for marks.
+
+zchunk_t *
+zs_pipe_encode (zs_pipe_t *self)
+{
+    zchunk_t *chunk = zchunk_new (NULL, 256);
+    value_t *value;
+    while ((value = (value_t *) zlistx_detach (self->values, NULL))) {
+        zchunk_extend (chunk, &value->type, 1);
+        if (value->type == 'w') {
+            uint64_t whole = (uint64_t) value->whole;
+            s_encode_varint (chunk, (whole << 1) ^ (uint64_t) (value->whole >> 63));
+        }
+        else
+        if (value->type == 'r') {
+            uint64_t bits;
+            memcpy (&bits, &value->real, sizeof (bits));
+            byte buffer [8];
+            int index;
+            for (index = 7; index >= 0; index--) {
+                buffer [index] = (byte) bits;
+                bits >>= 8;
+            }
+            zchunk_extend (chunk, buffer, sizeof (buffer));
+        }
+        else
+        if (value->type == 's') {
+            size_t size = strlen (value->string);
+            s_encode_varint (chunk, size);
+            zchunk_extend (chunk, value->string, size);
+        }
+        s_value_destroy (&value);
+    }
+    self->nbr_reals = 0;
+    return chunk;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Decode a buffer in binary wire format and append its values to the pipe.
+//  Returns 0 if OK, or -1 if the buffer was malformed, in which case the
+//  pipe is left unchanged.
+
+int
+zs_pipe_decode (zs_pipe_t *self, const byte *data, size_t size)
+{
+    size_t original_size = zlistx_size (self->values);
+    size_t original_reals = self->nbr_reals;
+    const byte *needle = data;
+    const byte *limit = data + size;
+    int rc = 0;
+
+    while (needle < limit && rc == 0) {
+        char type = (char) *needle++;
+        uint64_t number;
+        if (type == 'w') {
+            if (s_decode_varint (&needle, limit, &number) == 0)
+                zs_pipe_send_whole (self, (int64_t) (number >> 1) ^ -(int64_t) (number & 1));
+            else
+                rc = -1;
+        }
+        else
+        if (type == 'r') {
+            if (limit - needle >= 8) {
+                uint64_t bits = 0;
+                int index;
+                for (index = 0; index < 8; index++)
+                    bits = (bits << 8) | *needle++;
+                double real;
+                memcpy (&real, &bits, sizeof (real));
+                zs_pipe_send_real (self, real);
+            }
+            else
+                rc = -1;
+        }
+        else
+        if (type == 's') {
+            if (s_decode_varint (&needle, limit, &number) == 0
+            &&  number <= (uint64_t) (limit - needle)) {
+                s_send_string (self, (const char *) needle, (size_t) number);
+                needle += number;
+            }
+            else
+                rc = -1;
+        }
+        else
+        if (type == '|')
+            zs_pipe_mark (self);
+        else
+            rc = -1;
+    }
+    if (rc) {
+        //  Malformed input; drop whatever we managed to decode
+        while (zlistx_size (self->values) > original_size) {
+            value_t *value = (value_t *) zlistx_last (self->values);
+            zlistx_detach_cur (self->values);
+            s_value_destroy (&value);
+        }
+        self->nbr_reals = original_reals;
+    }
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return pipe contents, encoded in binary wire format, as a new frame.
+//  Caller must destroy the frame when done. This empties the pipe.
+
+zframe_t *
+zs_pipe_encode_frame (zs_pipe_t *self)
+{
+    zchunk_t *chunk = zs_pipe_encode (self);
+    zframe_t *frame = zframe_new (zchunk_data (chunk), zchunk_size (chunk));
+    zchunk_destroy (&chunk);
+    return frame;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Decode a frame in binary wire format and append its values to the pipe.
+//  Returns 0 if OK, or -1 if the frame was malformed.
+
+int
+zs_pipe_decode_frame (zs_pipe_t *self, zframe_t *frame)
+{
+    assert (frame);
+    return zs_pipe_decode (self, zframe_data (frame), zframe_size (frame));
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Append pipe contents, encoded in binary wire format, to the message as
+//  a single frame. This empties the pipe.
+
+void
+zs_pipe_encode_msg (zs_pipe_t *self, zmsg_t *msg)
+{
+    assert (msg);
+    zframe_t *frame = zs_pipe_encode_frame (self);
+    zmsg_append (msg, &frame);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Decode every frame of the message in order and append the values to the
+//  pipe. Returns 0 if OK, or -1 if any frame was malformed; frames decoded
+//  before the malformed one are kept.
+
+int
+zs_pipe_decode_msg (zs_pipe_t *self, zmsg_t *msg)
+{
+    assert (msg);
+    zframe_t *frame = zmsg_first (msg);
+    while (frame) {
+        if (zs_pipe_decode_frame (self, frame))
+            return -1;
+        frame = zmsg_next (msg);
+    }
+    return 0;
+}
+
+
+//  Ends a sentence on a ring; it is never destroyed or received
+static value_t
+s_end_of_sentence = { 0, 0, NULL, '.' };
+
+static void
+s_ring_value_destroy (void **item_p)
+{
+    if (*item_p != &s_end_of_sentence)
+        s_value_destroy ((value_t **) item_p);
+    *item_p = NULL;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Prepare a ring to carry pipe values, so that values left in the ring are
+//  destroyed with it. Call this once, when connecting the ring, before any
+//  thread sends on it.
+
+void
+zs_pipe_prepare_ring (zs_ring_t *ring)
+{
+    zs_ring_set_destructor (ring, s_ring_value_destroy);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Move all values in the pipe, including marks, onto the ring, and end
+//  them as one sentence. Values are handed over without copying, to be
+//  collected by another thread with zs_pipe_recv_ring. Returns 0 if OK, or
+//  -1 if the ring was closed, in which case unsent values stay in the pipe.
+
+int
+zs_pipe_send_ring (zs_pipe_t *self, zs_ring_t *ring)
+{
+    value_t *value;
+    while ((value = (value_t *) zlistx_detach (self->values, NULL))) {
+        //  Once pushed, the value belongs to the receiver
+        if (value->type == 'r')
+            self->nbr_reals--;
+        if (zs_ring_push (ring, value)) {
+            zlistx_add_start (self->values, value);
+            if (value->type == 'r')
+                self->nbr_reals++;
+            return -1;
+        }
+    }
+    return zs_ring_push (ring, &s_end_of_sentence);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Receive one sentence from the ring and append its values to the pipe,
+//  waiting according to the ring's backpressure mode. Returns 0 if OK, or
+//  -1 if the ring was closed and drained, or the process was interrupted.
+
+int
+zs_pipe_recv_ring (zs_pipe_t *self, zs_ring_t *ring)
+{
+    value_t *value;
+    while ((value = (value_t *) zs_ring_pop (ring))) {
+        if (value == &s_end_of_sentence)
+            return 0;
+        zlistx_add_end (self->values, value);
+        if (value->type == 'r')
+            self->nbr_reals++;
+    }
+    return -1;
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Print pipe contents, for debugging, prints nothing if pipe is empty
 
@@ -520,6 +835,7 @@ void
 zs_pipe_purge (zs_pipe_t *self)
 {
     zlistx_purge (self->values);
+    self->nbr_reals = 0;
 }
 
 
@@ -649,6 +965,24 @@ zs_pipe_test (bool verbose)
     assert (whole == 6);
     assert (!zs_pipe_recv (copy));
 
+    //  Test counted pull, keeping marks and reals
+    zs_pipe_purge (pipe);
+    zs_pipe_send_whole (pipe, 1);
+    zs_pipe_send_real  (pipe, 2.5);
+    zs_pipe_mark (pipe);
+    zs_pipe_send_whole (pipe, 3);
+    assert (zs_pipe_size (pipe) == 4);
+    zs_pipe_pull_count (copy, pipe, 3);
+    assert (zs_pipe_size (pipe) == 1);
+    assert (zs_pipe_size (copy) == 3);
+    assert (zs_pipe_realish (copy));
+    assert (!zs_pipe_realish (pipe));
+    zs_pipe_pull_count (copy, pipe, 10);
+    assert (zs_pipe_size (pipe) == 0);
+    char *chunks = zs_pipe_paste (copy);
+    assert (streq (chunks, "1 2.5, 3"));
+    zstr_free (&chunks);
+
     //  Test casting
     zs_pipe_purge (pipe);
     zs_pipe_send_whole (pipe, 1);
@@ -663,6 +997,120 @@ zs_pipe_test (bool verbose)
     real = zs_pipe_recv_real (pipe);
     assert (real == 3.0);
 
+    //  Test binary wire format
+    zs_pipe_purge (pipe);
+    zs_pipe_send_whole (pipe, 0);
+    zs_pipe_send_whole (pipe, -1);
+    zs_pipe_send_whole (pipe, INT64_MAX);
+    zs_pipe_send_whole (pipe, INT64_MIN);
+    zs_pipe_mark (pipe);
+    zs_pipe_send_real (pipe, 0.1 + 0.2);
+    zs_pipe_send_string (pipe, "");
+    zs_pipe_send_string (pipe, "Hello World");
+    zchunk_t *chunk = zs_pipe_encode (pipe);
+    assert (!zs_pipe_recv (pipe));
+    assert (!zs_pipe_realish (pipe));
+    //  Small wholes take two bytes
+    assert (zchunk_data (chunk) [0] == 'w');
+    assert (zchunk_data (chunk) [2] == 'w');
+    assert (zchunk_data (chunk) [3] == 1);
+
+    int status = zs_pipe_decode (copy, zchunk_data (chunk), zchunk_size (chunk));
+    assert (status == 0);
+    assert (zs_pipe_realish (copy));
+    assert (zs_pipe_recv_whole (copy) == 0);
+    assert (zs_pipe_recv_whole (copy) == -1);
+    assert (zs_pipe_recv_whole (copy) == INT64_MAX);
+    assert (zs_pipe_recv_whole (copy) == INT64_MIN);
+    assert (zs_pipe_recv (copy));
+    assert (zs_pipe_type (copy) == 'r');
+    assert (zs_pipe_real (copy) == 0.1 + 0.2);
+    assert (streq (zs_pipe_recv_string (copy), ""));
+    assert (streq (zs_pipe_recv_string (copy), "Hello World"));
+    assert (!zs_pipe_recv (copy));
+
+    //  Marks survive the round trip
+    status = zs_pipe_decode (copy, zchunk_data (chunk), zchunk_size (chunk));
+    assert (status == 0);
+    results = zs_pipe_paste (copy);
+    assert (streq (results, "0 -1 9223372036854775807 -9223372036854775808, 0.3  Hello World"));
+    zstr_free (&results);
+
+    //  Truncated input is rejected and leaves the pipe unchanged
+    zs_pipe_send_whole (copy, 99);
+    status = zs_pipe_decode (copy, zchunk_data (chunk), zchunk_size (chunk) - 1);
+    assert (status == -1);
+    assert (!zs_pipe_realish (copy));
+    assert (zs_pipe_recv_whole (copy) == 99);
+    assert (!zs_pipe_recv (copy));
+    byte garbage [] = { 'w', 0x80, 0x80 };
+    assert (zs_pipe_decode (copy, garbage, sizeof (garbage)) == -1);
+    garbage [0] = '?';
+    assert (zs_pipe_decode (copy, garbage, sizeof (garbage)) == -1);
+    assert (!zs_pipe_recv (copy));
+    zchunk_destroy (&chunk);
+
+    //  Frame and message adapters
+    zs_pipe_send_whole (pipe, 12345);
+    zs_pipe_send_string (pipe, "frame");
+    zmsg_t *msg = zmsg_new ();
+    zs_pipe_encode_msg (pipe, msg);
+    zs_pipe_send_real (pipe, 2.5);
+    zs_pipe_encode_msg (pipe, msg);
+    assert (zmsg_size (msg) == 2);
+    status = zs_pipe_decode_msg (copy, msg);
+    assert (status == 0);
+    zmsg_destroy (&msg);
+    assert (zs_pipe_recv_whole (copy) == 12345);
+    assert (streq (zs_pipe_recv_string (copy), "frame"));
+    assert (zs_pipe_recv_real (copy) == 2.5);
+    assert (!zs_pipe_recv (copy));
+
+    zs_pipe_send_whole (pipe, 42);
+    zframe_t *frame = zs_pipe_encode_frame (pipe);
+    assert (zframe_size (frame) == 2);
+    status = zs_pipe_decode_frame (copy, frame);
+    assert (status == 0);
+    zframe_destroy (&frame);
+    assert (zs_pipe_recv_whole (copy) == 42);
+
+    //  Sentences move across a ring without copying
+    zs_ring_t *ring = zs_ring_new (16);
+    zs_pipe_prepare_ring (ring);
+    zs_pipe_send_whole (pipe, 1);
+    zs_pipe_mark (pipe);
+    zs_pipe_send_real (pipe, 2.5);
+    status = zs_pipe_send_ring (pipe, ring);
+    assert (status == 0);
+    assert (!zs_pipe_realish (pipe));
+    zs_pipe_send_string (pipe, "next");
+    status = zs_pipe_send_ring (pipe, ring);
+    assert (status == 0);
+    status = zs_pipe_recv_ring (copy, ring);
+    assert (status == 0);
+    assert (zs_pipe_realish (copy));
+    results = zs_pipe_paste (copy);
+    assert (streq (results, "1, 2.5"));
+    zstr_free (&results);
+    zs_ring_close (ring);
+    status = zs_pipe_recv_ring (copy, ring);
+    assert (status == 0);
+    assert (streq (zs_pipe_recv_string (copy), "next"));
+    status = zs_pipe_recv_ring (copy, ring);
+    assert (status == -1);
+
+    //  Leftover values are destroyed along with the ring
+    zs_pipe_send_whole (pipe, 3);
+    status = zs_pipe_send_ring (pipe, ring);
+    assert (status == -1);
+    assert (zs_pipe_recv_whole (pipe) == 3);
+    zs_ring_destroy (&ring);
+    ring = zs_ring_new (16);
+    zs_pipe_prepare_ring (ring);
+    zs_pipe_send_string (pipe, "leftover");
+    zs_pipe_send_ring (pipe, ring);
+    zs_ring_destroy (&ring);
+
     zs_pipe_destroy (&copy);
     zs_pipe_destroy (&pipe);
     //  @end
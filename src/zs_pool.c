@@ -0,0 +1,217 @@
+/*  =========================================================================
+    zs_pool - fork-join pool of worker threads
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    The pool runs batches of independent jobs across a fixed set of worker
+    threads, and returns when the whole batch is done. The virtual machine
+    uses it to fan work out across cores.
+@discuss
+    Jobs are handed out one at a time under the pool mutex, so they should
+    be coarse (a chunk of values, not a single value). Only one batch runs
+    at a time; other callers wait their turn.
+@end
+*/
+
+#include "zs_classes.h"
+
+//  Structure of our class
+
+struct _zs_pool_t {
+    pthread_t *threads;             //  Worker threads
+    size_t nbr_threads;             //  Number of worker threads
+    pthread_mutex_t mutex;          //  Protects everything below
+    pthread_cond_t start;           //  Signals new batch, or shutdown
+    pthread_cond_t finish;          //  Signals end of batch
+    bool terminated;                //  Workers should stop
+    bool busy;                      //  A batch is running
+    uint64_t batch;                 //  Batch number, so workers see new ones
+    zs_pool_fn_t *fn;               //  Job function for current batch
+    void **args;                    //  Job arguments for current batch
+    size_t count;                   //  Number of jobs in batch
+    size_t next;                    //  Next job to hand out
+    size_t done;                    //  Number of jobs finished
+};
+
+//  Work on the current batch until there are no more jobs to hand out.
+//  Call with the mutex held; this releases it while running each job.
+static void
+s_work (zs_pool_t *self)
+{
+    while (self->next < self->count) {
+        void *args = self->args [self->next++];
+        zs_pool_fn_t *fn = self->fn;
+        pthread_mutex_unlock (&self->mutex);
+        (fn) (args);
+        pthread_mutex_lock (&self->mutex);
+        if (++self->done == self->count)
+            pthread_cond_broadcast (&self->finish);
+    }
+}
+
+static void *
+s_worker (void *args)
+{
+    zs_pool_t *self = (zs_pool_t *) args;
+    uint64_t batch = 0;
+    pthread_mutex_lock (&self->mutex);
+    while (true) {
+        while (!self->terminated && self->batch == batch)
+            pthread_cond_wait (&self->start, &self->mutex);
+        if (self->terminated)
+            break;
+        batch = self->batch;
+        s_work (self);
+    }
+    pthread_mutex_unlock (&self->mutex);
+    return NULL;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Create a new pool that runs up to size jobs at once, using size - 1
+//  worker threads plus the calling thread. If size is zero, uses one per
+//  available CPU. Returns the reference if successful, or NULL if
+//  construction failed due to lack of available memory.
+
+zs_pool_t *
+zs_pool_new (size_t size)
+{
+    zs_pool_t *self = (zs_pool_t *) zmalloc (sizeof (zs_pool_t));
+    if (self) {
+        if (size == 0) {
+            long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+            size = cpus > 0? (size_t) cpus: 1;
+        }
+        pthread_mutex_init (&self->mutex, NULL);
+        pthread_cond_init (&self->start, NULL);
+        pthread_cond_init (&self->finish, NULL);
+        self->nbr_threads = size - 1;
+        if (self->nbr_threads) {
+            self->threads = (pthread_t *) zmalloc (self->nbr_threads * sizeof (pthread_t));
+            assert (self->threads);
+        }
+        size_t index;
+        for (index = 0; index < self->nbr_threads; index++)
+            pthread_create (&self->threads [index], NULL, s_worker, self);
+    }
+    return self;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Destroy the pool, stopping its worker threads.
+
+void
+zs_pool_destroy (zs_pool_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zs_pool_t *self = *self_p;
+        pthread_mutex_lock (&self->mutex);
+        self->terminated = true;
+        pthread_cond_broadcast (&self->start);
+        pthread_mutex_unlock (&self->mutex);
+        size_t index;
+        for (index = 0; index < self->nbr_threads; index++)
+            pthread_join (self->threads [index], NULL);
+        free (self->threads);
+        pthread_cond_destroy (&self->finish);
+        pthread_cond_destroy (&self->start);
+        pthread_mutex_destroy (&self->mutex);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of jobs the pool can run at once.
+
+size_t
+zs_pool_size (zs_pool_t *self)
+{
+    return self->nbr_threads + 1;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Run a batch of jobs, calling fn once with each of the count args, and
+//  return when all of them have finished. The calling thread works on the
+//  batch as well. Jobs must not run batches on the same pool.
+
+void
+zs_pool_run (zs_pool_t *self, zs_pool_fn_t *fn, void **args, size_t count)
+{
+    pthread_mutex_lock (&self->mutex);
+    while (self->busy)
+        pthread_cond_wait (&self->finish, &self->mutex);
+    self->busy = true;
+    self->fn = fn;
+    self->args = args;
+    self->count = count;
+    self->next = 0;
+    self->done = 0;
+    self->batch++;
+    pthread_cond_broadcast (&self->start);
+    s_work (self);
+    while (self->done < self->count)
+        pthread_cond_wait (&self->finish, &self->mutex);
+    self->busy = false;
+    pthread_cond_broadcast (&self->finish);
+    pthread_mutex_unlock (&self->mutex);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Selftest
+
+static void
+s_test_job (void *args)
+{
+    int64_t *value = (int64_t *) args;
+    *value = *value * *value;
+}
+
+void
+zs_pool_test (bool verbose)
+{
+    printf (" * zs_pool: ");
+    if (verbose)
+        printf ("\n");
+
+    //  @selftest
+    zs_pool_t *pool = zs_pool_new (4);
+    assert (zs_pool_size (pool) == 4);
+
+    int64_t values [100];
+    void *args [100];
+    size_t index;
+    size_t cycle;
+    for (cycle = 0; cycle < 10; cycle++) {
+        for (index = 0; index < 100; index++) {
+            values [index] = (int64_t) index;
+            args [index] = &values [index];
+        }
+        zs_pool_run (pool, s_test_job, args, cycle * 10);
+        for (index = 0; index < 100; index++)
+            assert (values [index] == (int64_t) (index < cycle * 10? index * index: index));
+    }
+    zs_pool_destroy (&pool);
+
+    //  Default pool has one slot per CPU
+    pool = zs_pool_new (0);
+    assert (zs_pool_size (pool) >= 1);
+    zs_pool_destroy (&pool);
+    //  @end
+    printf ("OK\n");
+}
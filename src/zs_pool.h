@@ -0,0 +1,61 @@
+/*  =========================================================================
+    zs_pool - fork-join pool of worker threads
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZS_POOL_H_INCLUDED
+#define ZS_POOL_H_INCLUDED
+
+#include <czmq.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Opaque class structure
+#ifndef ZS_POOL_T_DEFINED
+typedef struct _zs_pool_t zs_pool_t;
+#endif
+
+//  Job function; called once for each job in a batch
+typedef void (zs_pool_fn_t) (void *args);
+
+//  @interface
+//  Create a new pool that runs up to size jobs at once, using size - 1
+//  worker threads plus the calling thread. If size is zero, uses one per
+//  available CPU. Returns the reference if successful, or NULL if
+//  construction failed due to lack of available memory.
+zs_pool_t *
+    zs_pool_new (size_t size);
+
+//  Destroy the pool, stopping its worker threads.
+void
+    zs_pool_destroy (zs_pool_t **self_p);
+
+//  Return number of jobs the pool can run at once.
+size_t
+    zs_pool_size (zs_pool_t *self);
+
+//  Run a batch of jobs, calling fn once with each of the count args, and
+//  return when all of them have finished. The calling thread works on the
+//  batch as well. Jobs must not run batches on the same pool.
+void
+    zs_pool_run (zs_pool_t *self, zs_pool_fn_t *fn, void **args, size_t count);
+
+//  Self test of this class
+void
+    zs_pool_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,8 +22,18 @@
 #include "zs_atomics.h"         //  Core atomics
 #include "zs_units_si.h"        //  SI scaling functions
 #include "zs_units_misc.h"      //  Miscellaneous scaling functions
+#if defined (__UNIX__)
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#endif
 #include "zs_strtod.c"          //  Coerced strtod function
 
+//  We read streams in chunks of this size, and work through mapped files
+//  in windows of this size, or larger for longer lines
+#define STREAM_CHUNK    65536
+#define MAP_WINDOW      (1024 * 1024)
+
 //  This holds an entry in the dictionary
 typedef struct {
     char *name;                 //  Function name
@@ -40,9 +50,15 @@ struct _zs_repl_t {
     zs_lex_t *lex;              //  Lexer instance
     zs_lex_token_t token;       //  Lexer token value
     const char *input;          //  Line of text we're parsing
+    size_t line_nbr;            //  Line number in file or stream
     int status;                 //  0 = OK, -1 = error
     zs_vm_t *vm;                //  Execution context
     bool completed;             //  Input formed a complete phrase
+    bool compiling;             //  Keep shell function, don't run it
+    size_t handle;              //  Shell function we kept, if any
+    size_t *released;           //  Handles released but not reclaimed
+    size_t nbr_released;        //  Number of released handles
+    size_t max_released;        //  Allocated size of released array
     size_t scope;               //  Nesting scope, 0..n
     //  Stack matching closing token
     zs_lex_token_t scope_stack [SCOPE_MAX];
@@ -51,23 +67,16 @@ struct _zs_repl_t {
 };
 
 
-//  ---------------------------------------------------------------------------
-//  Create a new repl engine, return the reference if successful, or NULL
-//  if construction failed due to lack of available memory.
-
-zs_repl_t *
-zs_repl_new (void)
+//  Create a repl engine around a virtual machine, which it takes ownership of
+static zs_repl_t *
+s_repl_new (zs_vm_t *vm)
 {
     zs_repl_t *self = (zs_repl_t *) zmalloc (sizeof (zs_repl_t));
     if (self) {
         self->fsm = fsm_new (self);
         self->lex = zs_lex_new ();
         self->completed = true;
-
-        self->vm = zs_vm_new ();
-        s_register_atomics (self->vm);
-        s_register_zs_units_si (self->vm);
-        s_register_zs_units_misc (self->vm);
+        self->vm = vm;
 
         //  Set token type to event map
         self->events [zs_lex_fn_inline] = fn_inline_event;
@@ -89,6 +98,40 @@ zs_repl_new (void)
 }
 
 
+//  ---------------------------------------------------------------------------
+//  Create a new repl engine, return the reference if successful, or NULL
+//  if construction failed due to lack of available memory.
+
+zs_repl_t *
+zs_repl_new (void)
+{
+    zs_vm_t *vm = zs_vm_new ();
+    if (!vm)
+        return NULL;
+    s_register_atomics (vm);
+    s_register_zs_units_si (vm);
+    s_register_zs_units_misc (vm);
+    return s_repl_new (vm);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Create a new repl engine that shares the functions defined so far in this
+//  one, without copying them. The new engine keeps its own definitions to
+//  itself. This engine must not execute any more input until all its forks
+//  are destroyed, though forks may execute from different threads. Returns
+//  the reference if successful, or NULL if construction failed.
+
+zs_repl_t *
+zs_repl_fork (zs_repl_t *self)
+{
+    zs_vm_t *vm = zs_vm_fork (self->vm);
+    if (!vm)
+        return NULL;
+    return s_repl_new (vm);
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Destroy the zs_repl and free all memory used by the object.
 
@@ -101,6 +144,7 @@ zs_repl_destroy (zs_repl_t **self_p)
         fsm_destroy (&self->fsm);
         zs_lex_destroy (&self->lex);
         zs_vm_destroy (&self->vm);
+        free (self->released);
         while ((int) self->scope >= 0)
             zstr_free (&self->loop_function [self->scope--]);
         free (self);
@@ -121,18 +165,15 @@ zs_repl_verbose (zs_repl_t *self, bool verbose)
 }
 
 
-//  ---------------------------------------------------------------------------
-//  Execute a buffer of code; to reset the engine you destroy it and create a
-//  new one. Returns 0 if OK, -1 on syntax errors or cataclysmic implosions of
-//  the Sun (can be resolved from context).
+//  Execute a buffer of code, which need not be null-terminated
 
-int
-zs_repl_execute (zs_repl_t *self, const char *input)
+static int
+s_execute (zs_repl_t *self, const char *input, size_t size)
 {
     self->input = input;
     self->completed = false;
     self->status = 0;
-    self->token = zs_lex_first (self->lex, self->input);
+    self->token = zs_lex_first_slice (self->lex, self->input, size);
     assert (self->token < zs_lex_tokens);
     fsm_set_next_event (self->fsm, self->events [self->token]);
     fsm_execute (self->fsm);
@@ -140,6 +181,260 @@ zs_repl_execute (zs_repl_t *self, const char *input)
 }
 
 
+//  Execute each complete line in the data, and a last partial line if this
+//  is the end of input. Prints the results of each completed line, if we
+//  have an output. Sets used_p to the size of the lines we executed. Returns
+//  0 if OK, -1 after a syntax error, or if the input ended in the middle of
+//  a statement.
+
+static int
+s_execute_lines (zs_repl_t *self, const char *data, size_t size, bool final,
+                 FILE *output, size_t *used_p)
+{
+    const char *line = data;
+    const char *limit = data + size;
+    int rc = 0;
+    while (line < limit) {
+        const char *end = (const char *) memchr (line, '\n', limit - line);
+        if (!end && !final)
+            break;              //  Wait for rest of line
+        const char *next = end? end + 1: limit;
+        if (!end)
+            end = limit;
+        if (end > line && end [-1] == '\r')
+            end--;              //  Accept CRLF line endings
+        self->line_nbr++;
+        if (s_execute (self, line, end - line)) {
+            rc = -1;
+            break;
+        }
+        if (output && self->completed) {
+            const char *results = zs_repl_results (self);
+            if (*results)
+                fprintf (output, "%s\n", results);
+        }
+        line = next;
+    }
+    *used_p = line - data;
+    if (final && rc == 0 && !self->completed)
+        rc = -1;
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Execute a buffer of code; to reset the engine you destroy it and create a
+//  new one. Returns 0 if OK, -1 on syntax errors or cataclysmic implosions of
+//  the Sun (can be resolved from context).
+
+int
+zs_repl_execute (zs_repl_t *self, const char *input)
+{
+    return s_execute (self, input, strlen (input));
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Execute a file of code, line by line, as if each line was passed to
+//  zs_repl_execute. Where possible the file is memory-mapped, so that the
+//  lexer works directly on the file contents and memory use does not grow
+//  with the file size. If output is not NULL, prints the results of each
+//  completed line to it. Stops at the first syntax error. Returns 0 if OK,
+//  or -1 if the file could not be read, had a syntax error, or ended in
+//  the middle of a statement.
+
+int
+zs_repl_execute_file (zs_repl_t *self, const char *filename, FILE *output)
+{
+#if defined (__UNIX__)
+    int handle = open (filename, O_RDONLY);
+    if (handle == -1)
+        return -1;
+    struct stat stat_buf;
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    //  We can only map regular files, and mmap refuses empty ones
+    if (fstat (handle, &stat_buf) == 0
+    &&  S_ISREG (stat_buf.st_mode)
+    &&  stat_buf.st_size > 0) {
+        size = (size_t) stat_buf.st_size;
+        data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, handle, 0);
+    }
+    close (handle);
+    if (data != MAP_FAILED) {
+        madvise (data, size, MADV_SEQUENTIAL);
+        self->line_nbr = 0;
+        //  Work through the file a window at a time, and drop the pages we
+        //  are done with, so that memory use does not grow with file size
+        size_t page_size = (size_t) sysconf (_SC_PAGESIZE);
+        size_t window = MAP_WINDOW;
+        size_t done = 0;
+        size_t dropped = 0;
+        int rc;
+        while (true) {
+            bool final = size - done <= window;
+            size_t used;
+            rc = s_execute_lines (self, (const char *) data + done,
+                                  final? size - done: window, final, output, &used);
+            if (rc || final)
+                break;
+            if (used == 0)
+                window *= 2;    //  Line is longer than window
+            done += used;
+            size_t drop = done / page_size * page_size;
+            if (drop > dropped) {
+                madvise ((byte *) data + dropped, drop - dropped, MADV_DONTNEED);
+                dropped = drop;
+            }
+        }
+        munmap (data, size);
+        return rc;
+    }
+#endif
+    FILE *file = fopen (filename, "r");
+    if (!file)
+        return -1;
+    int rc = zs_repl_execute_stream (self, file, output);
+    fclose (file);
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Execute code read from a stream, line by line, as if each line was passed
+//  to zs_repl_execute. Reads the stream in large chunks; a line or statement
+//  may span chunks, and memory use depends only on the longest line. If
+//  output is not NULL, prints the results of each completed line to it.
+//  Stops at the first syntax error. Returns 0 if OK, or -1 if the stream
+//  could not be read, had a syntax error, or ended in the middle of a
+//  statement.
+
+int
+zs_repl_execute_stream (zs_repl_t *self, FILE *input, FILE *output)
+{
+    size_t buffer_max = STREAM_CHUNK;
+    size_t buffer_size = 0;
+    char *buffer = (char *) malloc (buffer_max);
+    assert (buffer);
+
+    self->line_nbr = 0;
+    int rc = 0;
+    while (rc == 0) {
+        //  If the buffer is full, we have a very long line
+        if (buffer_size == buffer_max) {
+            buffer_max *= 2;
+            buffer = (char *) realloc (buffer, buffer_max);
+            assert (buffer);
+        }
+        size_t bytes = fread (buffer + buffer_size, 1, buffer_max - buffer_size, input);
+        buffer_size += bytes;
+        bool final = bytes == 0;
+        size_t used;
+        rc = s_execute_lines (self, buffer, buffer_size, final, output, &used);
+        if (final)
+            break;
+        //  Keep any partial line for the next chunk
+        memmove (buffer, buffer + used, buffer_size - used);
+        buffer_size -= used;
+    }
+    if (ferror (input))
+        rc = -1;
+    free (buffer);
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Compile a complete statement into a function that you can run many times
+//  with zs_repl_run, without lexing or compiling it again. The function
+//  sees the definitions made before it; later definitions do not change
+//  it. Returns a handle to the function, or 0 if the text had a syntax
+//  error, was not a complete statement, or the repl is in the middle of
+//  a statement.
+
+size_t
+zs_repl_compile (zs_repl_t *self, const char *text)
+{
+    if (!self->completed)
+        return 0;
+    self->compiling = true;
+    self->handle = 0;
+    int rc = s_execute (self, text, strlen (text));
+    self->compiling = false;
+    if (rc == 0 && !self->completed) {
+        //  Throw away the open definition
+        fsm_set_next_event (self->fsm, invalid_event);
+        fsm_execute (self->fsm);
+    }
+    if (rc || !self->handle) {
+        //  The lexer may be waiting for the rest of a string
+        zs_lex_destroy (&self->lex);
+        self->lex = zs_lex_new ();
+        assert (self->lex);
+        return 0;
+    }
+    return self->handle;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Run a function compiled by zs_repl_compile; fetch its output with
+//  zs_repl_results. Returns 0 if OK, or -1 if the function failed.
+
+int
+zs_repl_run (zs_repl_t *self, size_t handle)
+{
+    assert (handle);
+    assert (self->completed);
+    return zs_vm_run_function (self->vm, handle);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Release a function compiled by zs_repl_compile; the handle is then no
+//  longer valid. Functions are stored as a stack, so the memory is only
+//  reclaimed once every function defined after this one is also released.
+
+void
+zs_repl_release (zs_repl_t *self, size_t handle)
+{
+    assert (handle);
+    if (self->nbr_released == self->max_released) {
+        self->max_released = self->max_released? self->max_released * 2: 8;
+        self->released = (size_t *) realloc (self->released,
+            self->max_released * sizeof (size_t));
+        assert (self->released);
+    }
+    self->released [self->nbr_released++] = handle;
+
+    //  Pop released functions off the head, as long as we are not in the
+    //  middle of defining another one
+    while (self->completed) {
+        size_t head = zs_vm_head (self->vm);
+        size_t index;
+        for (index = 0; index < self->nbr_released; index++)
+            if (self->released [index] == head)
+                break;
+        if (index == self->nbr_released)
+            break;
+        self->released [index] = self->released [--self->nbr_released];
+        zs_vm_rollback (self->vm);
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of the line that zs_repl_execute_file or
+//  zs_repl_execute_stream executed last, counting from 1. After a syntax
+//  error, this is the line with the error.
+
+size_t
+zs_repl_line (zs_repl_t *self)
+{
+    return self->line_nbr;
+}
+
+
 //  *************************  Finite State Machine  *************************
 //  These actions are called from the generated FSM code.
 
@@ -163,7 +458,7 @@ get_next_token (zs_repl_t *self)
 static void
 compile_define_shell (zs_repl_t *self)
 {
-    zs_vm_compile_define (self->vm, "$shell$");
+    zs_vm_compile_define (self->vm, self->compiling? "$compiled$": "$shell$");
 }
 
 
@@ -174,15 +469,24 @@ compile_define_shell (zs_repl_t *self)
 static void
 compile_number (zs_repl_t *self)
 {
-    char *number = strdup (zs_lex_value (self->lex));
-    assert (strlen (number) > 0);
+    size_t size;
+    const char *slice = zs_lex_slice (self->lex, &size);
+    assert (size > 0);
 
     //  Check if it's a percentage; this also coerces number to real
     bool percentage = false;
-    if (number [strlen (number) - 1] == '%') {
-        number [strlen (number) - 1] = 0;
+    if (slice [size - 1] == '%') {
+        size--;
         percentage = true;
     }
+    //  The C library needs a null-terminated number; most numbers fit on
+    //  the stack, so we only allocate for very long ones
+    char buffer [64];
+    char *number = size < sizeof (buffer)? buffer: (char *) malloc (size + 1);
+    assert (number);
+    memcpy (number, slice, size);
+    number [size] = 0;
+
     //  Try to convert as whole number
     char *end = number;
     int64_t whole = (int64_t) strtoll (number, &end, 10);
@@ -197,7 +501,8 @@ compile_number (zs_repl_t *self)
         else
             fsm_set_exception (self->fsm, invalid_event);
     }
-    free (number);
+    if (number != buffer)
+        free (number);
 }
 
 
@@ -208,7 +513,9 @@ compile_number (zs_repl_t *self)
 static void
 compile_string (zs_repl_t *self)
 {
-    zs_vm_compile_string (self->vm, zs_lex_value (self->lex));
+    size_t size;
+    const char *slice = zs_lex_slice (self->lex, &size);
+    zs_vm_compile_slice (self->vm, slice, size);
 }
 
 
@@ -274,10 +581,11 @@ compile_unnest_or_commit (zs_repl_t *self)
 {
     if (self->scope)
         zs_vm_compile_xnest (self->vm);
-    else {
-        zs_vm_commit (self->vm);
+    else
+    if (zs_vm_commit (self->vm))
+        fsm_set_exception (self->fsm, invalid_event);
+    else
         fsm_set_exception (self->fsm, committed_event);
-    }
 }
 
 
@@ -401,7 +709,7 @@ static void
 check_if_completed (zs_repl_t *self)
 {
     if (self->scope == 0) {
-        fsm_set_exception (self->fsm, completed_event);
+        fsm_set_exception (self->fsm, self->compiling? compiled_event: completed_event);
         self->completed = true;
     }
 }
@@ -414,7 +722,8 @@ check_if_completed (zs_repl_t *self)
 static void
 compile_commit_shell (zs_repl_t *self)
 {
-    zs_vm_commit (self->vm);
+    if (zs_vm_commit (self->vm))
+        fsm_set_exception (self->fsm, invalid_event);
 }
 
 
@@ -442,6 +751,17 @@ rollback_the_function (zs_repl_t *self)
 }
 
 
+//  ---------------------------------------------------------------------------
+//  keep_compiled_shell
+//
+
+static void
+keep_compiled_shell (zs_repl_t *self)
+{
+    self->handle = zs_vm_head (self->vm);
+}
+
+
 //  ---------------------------------------------------------------------------
 //  signal_syntax_error
 //
@@ -522,6 +842,18 @@ s_repl_assert (zs_repl_t *self, const char *input, const char *expected)
     }
 }
 
+//  Return what was written to a temporary file, as a fresh string
+static char *
+s_read_back (FILE *file)
+{
+    long size = ftell (file);
+    rewind (file);
+    char *buffer = (char *) zmalloc (size + 1);
+    assert (buffer);
+    buffer [fread (buffer, 1, size, file)] = 0;
+    return buffer;
+}
+
 
 //  ---------------------------------------------------------------------------
 //  Selftest
@@ -548,6 +880,15 @@ zs_repl_test (bool verbose)
     s_repl_assert (repl, ")", "6");
     s_repl_assert (repl, "sub: (<hello>)", "");
     s_repl_assert (repl, "sub", "hello");
+    s_repl_assert (repl, "1,5 50% 2.5", "1.5 0.5 2.5");
+
+    //  Strings have no size limit
+    char *payload = (char *) zmalloc (5003);
+    memset (payload, 'p', 5000);
+    char *input = zsys_sprintf ("<%s>", payload);
+    s_repl_assert (repl, input, payload);
+    zstr_free (&input);
+    free (payload);
     s_repl_assert (repl, "sum (k (1 2 3) M (2))", "2006000");
     s_repl_assert (repl, "k", "1000");
     s_repl_assert (repl, "fn: (sum)", "");
@@ -560,6 +901,100 @@ zs_repl_test (bool verbose)
     s_repl_assert (repl, "1 [1 2] 0.5 [1 2] 0.49 [1 2] tally", "4");
     s_repl_assert (repl, "times (10) { 1 } tally", "10");
     s_repl_assert (repl, "2 times { <hello> 3 times { <world> } } tally", "8");
+    s_repl_assert (repl, "1 2 3 4 5 6 7 8 <K> pmap", "1000 2000 3000 4000 5000 6000 7000 8000");
+    s_repl_assert (repl, "1 2, 3 4 <K> pmap", "1 2 3000 4000");
+    s_repl_assert (repl, "KK: (<K> pmap K)", "");
+    s_repl_assert (repl, "1 2 3 4 <KK> pmap", "1000000 2000000 3000000 4000000");
+    s_repl_assert (repl, "<K> pmap", "");
+    s_repl_assert (repl, "4 parallel { 10 * }", "10 20 30 40");
+    s_repl_assert (repl, "100 parallel { } sum", "5050");
+    s_repl_assert (repl, "0 parallel { 1 }", "");
+    s_repl_assert (repl, "1 profile K (1 2 3) 0 profile", "1000 2000 3000");
+    //  A loop that ends on a tail call exits to it, not past it
+    s_repl_assert (repl, "a: (1 2 3 4)", "");
+    s_repl_assert (repl, "g: (1 times { 2 } a)", "");
+    s_repl_assert (repl, "g", "2 1 2 3 4");
+
+    //  Sessions forked off a shared library keep their own definitions
+    zs_repl_t *session = zs_repl_fork (repl);
+    s_repl_assert (session, "K (1 2)", "1000 2000");
+    s_repl_assert (session, "K: (10 *)", "");
+    s_repl_assert (session, "K (1 2)", "10 20");
+    zs_repl_t *other = zs_repl_fork (repl);
+    s_repl_assert (other, "K (1 2)", "1000 2000");
+    zs_repl_destroy (&other);
+    zs_repl_destroy (&session);
+    s_repl_assert (repl, "K (3)", "3000");
+
+    //  Compiled statements run many times, and keep the definitions they
+    //  were compiled with
+    size_t head = zs_vm_head (repl->vm);
+    size_t handle = zs_repl_compile (repl, "K (1 2 3) sum");
+    assert (handle);
+    assert (zs_repl_run (repl, handle) == 0);
+    assert (streq (zs_repl_results (repl), "6000"));
+    size_t other_handle = zs_repl_compile (repl, "<two> <strings>");
+    assert (other_handle);
+    s_repl_assert (repl, "K (1)", "1000");
+    assert (zs_repl_run (repl, handle) == 0);
+    assert (streq (zs_repl_results (repl), "6000"));
+    assert (zs_repl_run (repl, other_handle) == 0);
+    assert (streq (zs_repl_results (repl), "two strings"));
+    assert (zs_repl_compile (repl, "1 ] 2") == 0);
+    assert (zs_repl_compile (repl, "sum (1 2") == 0);
+    assert (zs_repl_compile (repl, "<open string") == 0);
+    assert (zs_repl_completed (repl));
+    s_repl_assert (repl, "sum (1 2 3)", "6");
+    zs_repl_release (repl, handle);
+    assert (zs_vm_head (repl->vm) == other_handle);
+    zs_repl_release (repl, other_handle);
+    assert (zs_vm_head (repl->vm) == head);
+    s_repl_assert (repl, "K (3)", "3000");
+
+    //  Streams execute line by line, and statements can span lines and
+    //  stream chunks
+    FILE *output = tmpfile ();
+    assert (output);
+    FILE *file = tmpfile ();
+    assert (file);
+    fprintf (file, "# Test script\ndouble: (2 *)\n\n");
+    fprintf (file, "double (1 2 3)\r\nsum (1 2\n3)\n<two\nlines> tally");
+    rewind (file);
+    assert (zs_repl_execute_stream (repl, file, output) == 0);
+    assert (zs_repl_line (repl) == 8);
+    fclose (file);
+    char *buffer = s_read_back (output);
+    fclose (output);
+    assert (streq (buffer, "2 4 6\n6\n1\n"));
+    free (buffer);
+    file = tmpfile ();
+    assert (file);
+    fprintf (file, "1 2 3\n4 ] 5\n6\n");
+    rewind (file);
+    assert (zs_repl_execute_stream (repl, file, NULL) == -1);
+    assert (zs_repl_line (repl) == 2);
+    fclose (file);
+    assert (zs_repl_execute_file (repl, "zs_repl_test.zs.none", NULL) == -1);
+
+    output = tmpfile ();
+    assert (output);
+    file = tmpfile ();
+    assert (file);
+    uint line_nbr;
+    for (line_nbr = 0; line_nbr < 20000; line_nbr++)
+        fprintf (file, "%u 1 sum\n", line_nbr);
+    fprintf (file, "sum (1 2\n");
+    rewind (file);
+    assert (zs_repl_execute_stream (repl, file, output) == -1);
+    assert (zs_repl_line (repl) == 20001);
+    fclose (file);
+    buffer = s_read_back (output);
+    fclose (output);
+    assert (strncmp (buffer, "1\n2\n3\n", 6) == 0);
+    assert (strstr (buffer, "\n20000\n"));
+    free (buffer);
+    s_repl_assert (repl, "3)", "6");
+
     zs_repl_destroy (&repl);
     //  @end
     printf ("OK\n");
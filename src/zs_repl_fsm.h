@@ -35,14 +35,15 @@ typedef enum {
     start_loop_event = 7,
     fn_close_event = 8,
     completed_event = 9,
-    committed_event = 10,
-    phrase_event = 11,
-    sentence_event = 12,
-    end_menu_event = 13,
-    end_loop_event = 14,
-    finished_event = 15,
-    loop_event = 16,
-    invalid_event = 17
+    compiled_event = 10,
+    committed_event = 11,
+    phrase_event = 12,
+    sentence_event = 13,
+    end_menu_event = 14,
+    end_loop_event = 15,
+    finished_event = 16,
+    loop_event = 17,
+    invalid_event = 18
 } event_t;
 
 //  Names for state machine logging and error reporting
@@ -67,6 +68,7 @@ s_event_name [] = {
     "start_loop",
     "fn_close",
     "completed",
+    "compiled",
     "committed",
     "phrase",
     "sentence",
@@ -95,6 +97,7 @@ static void compile_end_of_sentence (zs_repl_t *self);
 static void compile_commit_shell (zs_repl_t *self);
 static void run_virtual_machine (zs_repl_t *self);
 static void rollback_the_function (zs_repl_t *self);
+static void keep_compiled_shell (zs_repl_t *self);
 static void compile_unnest_or_commit (zs_repl_t *self);
 static void compile_end_of_phrase (zs_repl_t *self);
 static void compile_end_menu (zs_repl_t *self);
@@ -102,6 +105,29 @@ static void compile_end_loop (zs_repl_t *self);
 static void check_if_completed (zs_repl_t *self);
 static void signal_syntax_error (zs_repl_t *self);
 
+//  Transition for each state and event; this is the case in fsm_execute
+//  that runs the action list, or 0 if the state does not handle the event
+static byte
+s_transition [][19] = {
+    { 0 },
+    //  starting
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 9, 0, 8, 8, 8, 8, 10, 8, 8 },
+    //  building_shell
+    { 0, 11, 12, 13, 14, 8, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 10, 8, 8 },
+    //  building_function
+    { 0, 11, 12, 13, 14, 8, 15, 16, 25, 9, 9, 20, 21, 22, 23, 24, 10, 8, 8 },
+    //  defaults
+    { 0, 8, 8, 8, 8, 8, 8, 0, 8, 9, 9, 0, 8, 8, 8, 8, 10, 8, 8 }
+};
+
+//  Define FSM_QUIET to build the state machine without animation, so it
+//  does not test the animate flag in every cycle
+#if defined (FSM_QUIET)
+#   define fsm_animating(self)  false
+#else
+#   define fsm_animating(self)  ((self)->animate)
+#endif
+
 //  This is the context block for a FSM thread; use the setter
 //  methods to set the FSM properties.
 
@@ -191,1165 +217,393 @@ fsm_execute (fsm_t *self)
         self->event = self->next_event;
         self->next_event = NULL_event;
         self->exception = NULL_event;
-        if (self->animate) {
+        if (fsm_animating (self)) {
             zsys_debug ("zs_repl: %s:", s_state_name [self->state]);
             zsys_debug ("zs_repl:           %s", s_event_name [self->event]);
         }
-        if (self->state == starting_state) {
-            if (self->event == number_event) {
-                if (!self->exception) {
-                    //  compile_define_shell
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_define_shell");
-                    compile_define_shell (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_number
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_number");
-                    compile_number (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+        switch (s_transition [self->state][self->event]) {
+            case 1:
+                //  starting: number
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_define_shell");
+                compile_define_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_number");
+                compile_number (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == string_event) {
-                if (!self->exception) {
-                    //  compile_define_shell
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_define_shell");
-                    compile_define_shell (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_string
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_string");
-                    compile_string (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 2:
+                //  starting: string
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_define_shell");
+                compile_define_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_string");
+                compile_string (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == fn_inline_event) {
-                if (!self->exception) {
-                    //  compile_define_shell
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_define_shell");
-                    compile_define_shell (self->parent);
-                }
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_inline_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_inline_call");
-                    compile_inline_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 3:
+                //  starting: fn_inline
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_define_shell");
+                compile_define_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ remember_loop_function");
+                remember_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_inline_call");
+                compile_inline_call (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == fn_nested_event) {
-                if (!self->exception) {
-                    //  compile_define_shell
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_define_shell");
-                    compile_define_shell (self->parent);
-                }
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_nested_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_nested_call");
-                    compile_nested_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 4:
+                //  starting: fn_nested
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_define_shell");
+                compile_define_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ remember_loop_function");
+                remember_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_nested_call");
+                compile_nested_call (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == fn_define_event) {
-                if (!self->exception) {
-                    //  compile_define
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_define");
-                    compile_define (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 5:
+                //  starting: fn_define
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_define");
+                compile_define (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_function_state;
-            }
-            else
-            if (self->event == start_menu_event) {
-                if (!self->exception) {
-                    //  compile_start_menu
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_menu");
-                    compile_start_menu (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 6:
+                //  starting: start_menu
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_start_menu");
+                compile_start_menu (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == start_loop_event) {
-                if (!self->exception) {
-                    //  require_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ require_loop_function");
-                    require_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_start_loop
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_loop");
-                    compile_start_loop (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
+                break;
+            case 7:
+                //  starting: start_loop
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ require_loop_function");
+                require_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_start_loop");
+                compile_start_loop (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
                 if (!self->exception)
                     self->state = building_shell_state;
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  check_if_completed
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ check_if_completed");
-                    check_if_completed (self->parent);
-                }
-            }
-            else
-            if (self->event == completed_event) {
-                //  No action - just logging
-                if (self->animate)
-                    zsys_debug ("zs_repl:               $ completed");
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == phrase_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == sentence_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == end_menu_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == end_loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_close_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == invalid_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else {
-                //  Handle unexpected internal events
-                zsys_warning ("zs_repl: unhandled event %s in %s",
-                    s_event_name [self->event], s_state_name [self->state]);
-                exit (-1);
-            }
-        }
-        else
-        if (self->state == building_shell_state) {
-            if (self->event == fn_close_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_unnest
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_unnest");
-                    compile_unnest (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == completed_event) {
-                if (!self->exception) {
-                    //  compile_end_of_sentence
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_of_sentence");
-                    compile_end_of_sentence (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_commit_shell
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_commit_shell");
-                    compile_commit_shell (self->parent);
-                }
-                if (!self->exception) {
-                    //  run_virtual_machine
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ run_virtual_machine");
-                    run_virtual_machine (self->parent);
-                }
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == number_event) {
-                if (!self->exception) {
-                    //  compile_number
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_number");
-                    compile_number (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == string_event) {
-                if (!self->exception) {
-                    //  compile_string
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_string");
-                    compile_string (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_inline_event) {
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_inline_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_inline_call");
-                    compile_inline_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_nested_event) {
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_nested_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_nested_call");
-                    compile_nested_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == committed_event) {
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == phrase_event) {
-                if (!self->exception) {
-                    //  compile_end_of_phrase
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_of_phrase");
-                    compile_end_of_phrase (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == sentence_event) {
-                if (!self->exception) {
-                    //  compile_end_of_sentence
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_of_sentence");
-                    compile_end_of_sentence (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == start_menu_event) {
-                if (!self->exception) {
-                    //  compile_start_menu
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_menu");
-                    compile_start_menu (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == end_menu_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_end_menu
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_menu");
-                    compile_end_menu (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == start_loop_event) {
-                if (!self->exception) {
-                    //  require_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ require_loop_function");
-                    require_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_start_loop
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_loop");
-                    compile_start_loop (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == end_loop_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_end_loop
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_loop");
-                    compile_end_loop (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  check_if_completed
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ check_if_completed");
-                    check_if_completed (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_define_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == invalid_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else {
-                //  Handle unexpected internal events
-                zsys_warning ("zs_repl: unhandled event %s in %s",
-                    s_event_name [self->event], s_state_name [self->state]);
-                exit (-1);
-            }
-        }
-        else
-        if (self->state == building_function_state) {
-            if (self->event == number_event) {
-                if (!self->exception) {
-                    //  compile_number
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_number");
-                    compile_number (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == string_event) {
-                if (!self->exception) {
-                    //  compile_string
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_string");
-                    compile_string (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_inline_event) {
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_inline_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_inline_call");
-                    compile_inline_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_nested_event) {
-                if (!self->exception) {
-                    //  remember_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ remember_loop_function");
-                    remember_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_nested_call
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_nested_call");
-                    compile_nested_call (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == fn_close_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_unnest_or_commit
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_unnest_or_commit");
-                    compile_unnest_or_commit (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == committed_event) {
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == phrase_event) {
-                if (!self->exception) {
-                    //  compile_end_of_phrase
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_of_phrase");
-                    compile_end_of_phrase (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == sentence_event) {
-                if (!self->exception) {
-                    //  compile_end_of_sentence
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_of_sentence");
-                    compile_end_of_sentence (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == start_menu_event) {
-                if (!self->exception) {
-                    //  compile_start_menu
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_menu");
-                    compile_start_menu (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == end_menu_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_end_menu
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_menu");
-                    compile_end_menu (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == start_loop_event) {
-                if (!self->exception) {
-                    //  require_loop_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ require_loop_function");
-                    require_loop_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_start_loop
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_start_loop");
-                    compile_start_loop (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == end_loop_event) {
-                if (!self->exception) {
-                    //  pop_and_check_scope
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ pop_and_check_scope");
-                    pop_and_check_scope (self->parent);
-                }
-                if (!self->exception) {
-                    //  compile_end_loop
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ compile_end_loop");
-                    compile_end_loop (self->parent);
-                }
-                if (!self->exception) {
-                    //  get_next_token
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ get_next_token");
-                    get_next_token (self->parent);
-                }
-            }
-            else
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  check_if_completed
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ check_if_completed");
-                    check_if_completed (self->parent);
-                }
-            }
-            else
-            if (self->event == completed_event) {
+                break;
+            case 8:
+                //  starting: fn_close
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ rollback_the_function");
+                rollback_the_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ signal_syntax_error");
+                signal_syntax_error (self->parent);
+                if (!self->exception)
+                    self->state = starting_state;
+                break;
+            case 9:
+                //  starting: completed
                 //  No action - just logging
-                if (self->animate)
-                    zsys_debug ("zs_repl:               $ completed");
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_define_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == invalid_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else {
-                //  Handle unexpected internal events
-                zsys_warning ("zs_repl: unhandled event %s in %s",
-                    s_event_name [self->event], s_state_name [self->state]);
-                exit (-1);
-            }
-        }
-        else
-        if (self->state == defaults_state) {
-            if (self->event == finished_event) {
-                if (!self->exception) {
-                    //  check_if_completed
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ check_if_completed");
-                    check_if_completed (self->parent);
-                }
-            }
-            else
-            if (self->event == completed_event) {
-                //  No action - just logging
-                if (self->animate)
-                    zsys_debug ("zs_repl:               $ completed");
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == number_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == string_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_inline_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_nested_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_define_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == phrase_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == sentence_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == start_menu_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == end_menu_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == end_loop_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == fn_close_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else
-            if (self->event == invalid_event) {
-                if (!self->exception) {
-                    //  rollback_the_function
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ rollback_the_function");
-                    rollback_the_function (self->parent);
-                }
-                if (!self->exception) {
-                    //  signal_syntax_error
-                    if (self->animate)
-                        zsys_debug ("zs_repl:               $ signal_syntax_error");
-                    signal_syntax_error (self->parent);
-                }
-                if (!self->exception)
-                    self->state = starting_state;
-            }
-            else {
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ %s", s_event_name [self->event]);
+                self->state = starting_state;
+                break;
+            case 10:
+                //  starting: finished
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ check_if_completed");
+                check_if_completed (self->parent);
+                break;
+            case 11:
+                //  building_shell: number
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_number");
+                compile_number (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 12:
+                //  building_shell: string
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_string");
+                compile_string (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 13:
+                //  building_shell: fn_inline
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ remember_loop_function");
+                remember_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_inline_call");
+                compile_inline_call (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 14:
+                //  building_shell: fn_nested
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ remember_loop_function");
+                remember_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_nested_call");
+                compile_nested_call (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 15:
+                //  building_shell: start_menu
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_start_menu");
+                compile_start_menu (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 16:
+                //  building_shell: start_loop
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ require_loop_function");
+                require_loop_function (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_start_loop");
+                compile_start_loop (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 17:
+                //  building_shell: fn_close
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ pop_and_check_scope");
+                pop_and_check_scope (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_unnest");
+                compile_unnest (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 18:
+                //  building_shell: completed
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_of_sentence");
+                compile_end_of_sentence (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_commit_shell");
+                compile_commit_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ run_virtual_machine");
+                run_virtual_machine (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ rollback_the_function");
+                rollback_the_function (self->parent);
+                if (!self->exception)
+                    self->state = starting_state;
+                break;
+            case 19:
+                //  building_shell: compiled
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_of_sentence");
+                compile_end_of_sentence (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_commit_shell");
+                compile_commit_shell (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ keep_compiled_shell");
+                keep_compiled_shell (self->parent);
+                if (!self->exception)
+                    self->state = starting_state;
+                break;
+            case 20:
+                //  building_shell: committed
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                if (!self->exception)
+                    self->state = starting_state;
+                break;
+            case 21:
+                //  building_shell: phrase
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_of_phrase");
+                compile_end_of_phrase (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 22:
+                //  building_shell: sentence
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_of_sentence");
+                compile_end_of_sentence (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 23:
+                //  building_shell: end_menu
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ pop_and_check_scope");
+                pop_and_check_scope (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_menu");
+                compile_end_menu (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 24:
+                //  building_shell: end_loop
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ pop_and_check_scope");
+                pop_and_check_scope (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_end_loop");
+                compile_end_loop (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            case 25:
+                //  building_function: fn_close
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ pop_and_check_scope");
+                pop_and_check_scope (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ compile_unnest_or_commit");
+                compile_unnest_or_commit (self->parent);
+                if (self->exception)
+                    break;
+                if (fsm_animating (self))
+                    zsys_debug ("zs_repl:               $ get_next_token");
+                get_next_token (self->parent);
+                break;
+            default:
                 //  Handle unexpected internal events
                 zsys_warning ("zs_repl: unhandled event %s in %s",
                     s_event_name [self->event], s_state_name [self->state]);
                 exit (-1);
-            }
         }
         //  If we had an exception event, interrupt normal programming
         if (self->exception) {
-            if (self->animate)
+            if (fsm_animating (self))
                 zsys_debug ("zs_repl:               ! %s", s_event_name [self->exception]);
             self->next_event = self->exception;
         }
         else
-        if (self->animate)
+        if (fsm_animating (self))
             zsys_debug ("zs_repl:               > %s", s_state_name [self->state]);
     }
 }
@@ -0,0 +1,354 @@
+/*  =========================================================================
+    zs_ring - single-producer, single-consumer ring between threads
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    A ring is a bounded, lock-free queue of pointers that connects exactly
+    one producer thread to exactly one consumer thread. We use it to wire
+    the output of one virtual machine into the input of another, so that
+    sentences flow between cores without being copied.
+@discuss
+    The head is only written by the producer and the tail only by the
+    consumer. Each lives in its own cache line, along with that side's
+    cached copy of the other index, so the two cores do not fight over
+    the same line on every item.
+
+    When the ring is full or empty the waiting side either spins, yields,
+    or sleeps on a condition variable. Sleepers announce themselves in the
+    waiting counter; the other side only touches the mutex when someone
+    is actually asleep.
+@end
+*/
+
+#include "zs_classes.h"
+
+#define CACHE_LINE  64
+
+//  Structure of our class
+
+struct _zs_ring_t {
+    byte pad0 [CACHE_LINE];
+    //  Owned by the producer
+    size_t head;                    //  Next slot to write
+    size_t tail_cache;              //  Producer's last view of tail
+    byte pad1 [CACHE_LINE - 2 * sizeof (size_t)];
+    //  Owned by the consumer
+    size_t tail;                    //  Next slot to read
+    size_t head_cache;              //  Consumer's last view of head
+    byte pad2 [CACHE_LINE - 2 * sizeof (size_t)];
+    //  Shared, rarely written
+    void **slots;                   //  Ring of items
+    size_t mask;                    //  Ring size - 1
+    zs_ring_mode_t mode;            //  Backpressure mode
+    czmq_destructor *destructor;    //  Destroys leftover items
+    int closed;                     //  Ring was closed
+    int waiting;                    //  Number of sleeping threads
+    pthread_mutex_t mutex;          //  Only used for sleeping
+    pthread_cond_t cond;
+};
+
+
+//  ---------------------------------------------------------------------------
+//  Create a new ring that holds up to limit items; the limit is rounded up
+//  to a power of two. Returns the reference if successful, or NULL if
+//  construction failed due to lack of available memory.
+
+zs_ring_t *
+zs_ring_new (size_t limit)
+{
+    zs_ring_t *self = (zs_ring_t *) zmalloc (sizeof (zs_ring_t));
+    if (self) {
+        size_t size = 2;
+        while (size < limit)
+            size <<= 1;
+        self->slots = (void **) zmalloc (size * sizeof (void *));
+        if (!self->slots) {
+            free (self);
+            return NULL;
+        }
+        self->mask = size - 1;
+        self->mode = zs_ring_block;
+        pthread_mutex_init (&self->mutex, NULL);
+        pthread_cond_init (&self->cond, NULL);
+    }
+    return self;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Destroy the ring and free all memory used by it. Any items still in the
+//  ring are passed to the destructor, if one was set.
+
+void
+zs_ring_destroy (zs_ring_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zs_ring_t *self = *self_p;
+        while (self->tail != self->head) {
+            void *item = self->slots [self->tail++ & self->mask];
+            if (self->destructor)
+                (self->destructor) (&item);
+        }
+        pthread_cond_destroy (&self->cond);
+        pthread_mutex_destroy (&self->mutex);
+        free (self->slots);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Set the backpressure mode; call this before any thread uses the ring.
+
+void
+zs_ring_set_mode (zs_ring_t *self, zs_ring_mode_t mode)
+{
+    self->mode = mode;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Set a destructor for items left in the ring when it is destroyed.
+
+void
+zs_ring_set_destructor (zs_ring_t *self, czmq_destructor destructor)
+{
+    self->destructor = destructor;
+}
+
+
+//  Return true if the producer can push, refreshing its view of the tail
+//  only when the cached view says the ring is full.
+static bool
+s_can_push (zs_ring_t *self)
+{
+    if (self->head - self->tail_cache <= self->mask)
+        return true;
+    self->tail_cache = __atomic_load_n (&self->tail, __ATOMIC_ACQUIRE);
+    return self->head - self->tail_cache <= self->mask;
+}
+
+//  Return true if the consumer can pop, refreshing its view of the head
+//  only when the cached view says the ring is empty.
+static bool
+s_can_pop (zs_ring_t *self)
+{
+    if (self->tail != self->head_cache)
+        return true;
+    self->head_cache = __atomic_load_n (&self->head, __ATOMIC_ACQUIRE);
+    return self->tail != self->head_cache;
+}
+
+//  Wait once, according to the ring mode, for the other side to move. The
+//  sleeper registers before checking again, and the waker publishes before
+//  checking for sleepers, so one of them always sees the other.
+static void
+s_wait (zs_ring_t *self, bool (*ready) (zs_ring_t *self), uint *attempt)
+{
+    if (self->mode == zs_ring_spin) {
+        //  Let the other side run now and then, in case it shares our core
+        if (++*attempt % 1024 == 0)
+            sched_yield ();
+#if defined (__i386__) || defined (__x86_64__)
+        else
+            __builtin_ia32_pause ();
+#endif
+    }
+    else
+    if (self->mode == zs_ring_yield)
+        sched_yield ();
+    else {
+        pthread_mutex_lock (&self->mutex);
+        __atomic_add_fetch (&self->waiting, 1, __ATOMIC_SEQ_CST);
+        if (!ready (self) && !__atomic_load_n (&self->closed, __ATOMIC_SEQ_CST)) {
+            //  Time out now and then so we notice interrupts
+            struct timespec deadline;
+            clock_gettime (CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 10 * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait (&self->cond, &self->mutex, &deadline);
+        }
+        __atomic_sub_fetch (&self->waiting, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock (&self->mutex);
+    }
+}
+
+//  Wake the other side if it is sleeping
+static void
+s_wake (zs_ring_t *self)
+{
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&self->waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock (&self->mutex);
+        pthread_cond_broadcast (&self->cond);
+        pthread_mutex_unlock (&self->mutex);
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Producer: push an item onto the ring, waiting while the ring is full.
+//  Returns 0 if OK, or -1 if the ring was closed or the process was
+//  interrupted; the caller then still owns the item.
+
+int
+zs_ring_push (zs_ring_t *self, void *item)
+{
+    uint attempt = 0;
+    while (!s_can_push (self)) {
+        if (zs_ring_closed (self) || zctx_interrupted)
+            return -1;
+        s_wait (self, s_can_push, &attempt);
+    }
+    if (zs_ring_closed (self))
+        return -1;
+    self->slots [self->head & self->mask] = item;
+    __atomic_store_n (&self->head, self->head + 1, __ATOMIC_RELEASE);
+    s_wake (self);
+    return 0;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Consumer: pop the oldest item off the ring, waiting while the ring is
+//  empty. Returns NULL if the ring is closed and empty, or the process was
+//  interrupted.
+
+void *
+zs_ring_pop (zs_ring_t *self)
+{
+    uint attempt = 0;
+    while (!s_can_pop (self)) {
+        //  Check again after seeing closed, as the producer may have pushed
+        //  its last items just before closing
+        if (zs_ring_closed (self) && !s_can_pop (self))
+            return NULL;
+        if (zctx_interrupted)
+            return NULL;
+        s_wait (self, s_can_pop, &attempt);
+    }
+    void *item = self->slots [self->tail & self->mask];
+    __atomic_store_n (&self->tail, self->tail + 1, __ATOMIC_RELEASE);
+    s_wake (self);
+    return item;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Close the ring. Either side may do this; the producer can no longer push
+//  and the consumer gets NULL once it has drained the ring.
+
+void
+zs_ring_close (zs_ring_t *self)
+{
+    __atomic_store_n (&self->closed, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock (&self->mutex);
+    pthread_cond_broadcast (&self->cond);
+    pthread_mutex_unlock (&self->mutex);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return true if the ring was closed.
+
+bool
+zs_ring_closed (zs_ring_t *self)
+{
+    return __atomic_load_n (&self->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of items in the ring; this is a snapshot and may be out of
+//  date by the time the caller looks at it.
+
+size_t
+zs_ring_size (zs_ring_t *self)
+{
+    return __atomic_load_n (&self->head, __ATOMIC_ACQUIRE)
+         - __atomic_load_n (&self->tail, __ATOMIC_ACQUIRE);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Selftest
+
+#define TEST_ITEMS  100000
+
+static void *
+s_test_producer (void *args)
+{
+    zs_ring_t *ring = (zs_ring_t *) args;
+    size_t count;
+    for (count = 1; count <= TEST_ITEMS; count++)
+        if (zs_ring_push (ring, (void *) count))
+            break;
+    zs_ring_close (ring);
+    return NULL;
+}
+
+static void
+s_test_item_destroy (void **item_p)
+{
+    free (*item_p);
+    *item_p = NULL;
+}
+
+void
+zs_ring_test (bool verbose)
+{
+    printf (" * zs_ring: ");
+    if (verbose)
+        printf ("\n");
+
+    //  @selftest
+    //  Items come out in order, in every backpressure mode
+    int mode;
+    for (mode = zs_ring_block; mode <= zs_ring_yield; mode++) {
+        zs_ring_t *ring = zs_ring_new (100);
+        zs_ring_set_mode (ring, (zs_ring_mode_t) mode);
+        pthread_t producer;
+        pthread_create (&producer, NULL, s_test_producer, ring);
+        size_t expected = 1;
+        void *item;
+        while ((item = zs_ring_pop (ring)))
+            assert ((size_t) item == expected++);
+        assert (expected == TEST_ITEMS + 1);
+        pthread_join (producer, NULL);
+        assert (zs_ring_closed (ring));
+        assert (zs_ring_size (ring) == 0);
+        zs_ring_destroy (&ring);
+    }
+    //  A full ring refuses more items once closed, and leftover items go
+    //  to the destructor
+    zs_ring_t *ring = zs_ring_new (3);
+    zs_ring_set_destructor (ring, s_test_item_destroy);
+    size_t count;
+    for (count = 0; count < 4; count++)
+        assert (zs_ring_push (ring, strdup ("item")) == 0);
+    assert (zs_ring_size (ring) == 4);
+    zs_ring_close (ring);
+    char *item = strdup ("refused");
+    assert (zs_ring_push (ring, item) == -1);
+    free (item);
+    item = (char *) zs_ring_pop (ring);
+    assert (streq (item, "item"));
+    free (item);
+    zs_ring_destroy (&ring);
+    //  @end
+    printf ("OK\n");
+}
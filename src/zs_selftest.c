@@ -32,6 +32,9 @@ main (int argc, char *argv [])
     printf ("Running zs selftests...\n");
 
     zs_pipe_test (verbose);
+    zs_ring_test (verbose);
+    zs_pool_test (verbose);
+    zs_trace_test (verbose);
     zs_vm_test (verbose);
     zs_lex_test (verbose);
     zs_repl_test (verbose);
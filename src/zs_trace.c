@@ -0,0 +1,331 @@
+/*  =========================================================================
+    zs_trace - ring of binary trace events
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    A trace ring holds the last N instructions a virtual machine executed,
+    as fixed-size binary events. Recording an event costs a clock read and
+    a few stores, so tracing can stay on in production. The ring is plain
+    memory, so after a crash the last events are still there in the core
+    file, and the dumpers turn them into text or Chrome trace JSON.
+@discuss
+    One thread records into a ring; any thread may take a snapshot. The
+    recorder publishes its event count after each event, and a reader
+    checks that count again after copying, dropping any events that the
+    recorder may have overwritten in the meantime. Events are copied as
+    64-bit words so that torn reads are harmless.
+
+    The virtual machine prints the ring of the context that was running
+    when the process aborts, so a failed assertion shows how we got there.
+@end
+*/
+
+#include "zs_classes.h"
+
+#define EVENT_WORDS (sizeof (zs_trace_event_t) / sizeof (uint64_t))
+
+//  Structure of our class
+
+struct _zs_trace_t {
+    uint64_t *slots;                //  Ring of events, as words
+    size_t mask;                    //  Ring size - 1
+    uint64_t head;                  //  Number of events recorded
+};
+
+
+//  ---------------------------------------------------------------------------
+//  Create a new trace ring that keeps the most recent events. It holds one
+//  less than the smallest power of two above limit, so at least limit
+//  events. Returns the reference if successful, or NULL if construction
+//  failed due to lack of available memory.
+
+zs_trace_t *
+zs_trace_new (size_t limit)
+{
+    assert (sizeof (zs_trace_event_t) % sizeof (uint64_t) == 0);
+    zs_trace_t *self = (zs_trace_t *) zmalloc (sizeof (zs_trace_t));
+    if (self) {
+        size_t size = 2;
+        while (size <= limit)
+            size <<= 1;
+        self->slots = (uint64_t *) zmalloc (size * sizeof (zs_trace_event_t));
+        if (!self->slots) {
+            free (self);
+            return NULL;
+        }
+        self->mask = size - 1;
+    }
+    return self;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Destroy the trace ring and free all memory used by it.
+
+void
+zs_trace_destroy (zs_trace_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zs_trace_t *self = *self_p;
+        free (self->slots);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Record one event, overwriting the oldest event if the ring is full. Only
+//  one thread may record into a ring.
+
+void
+zs_trace_record (zs_trace_t *self, const zs_trace_event_t *event)
+{
+    uint64_t words [EVENT_WORDS];
+    memcpy (words, event, sizeof (zs_trace_event_t));
+    uint64_t *slot = self->slots + (self->head & self->mask) * EVENT_WORDS;
+    //  Readers that see any of these words must also see the count of
+    //  events before this one, so they know the slot is being reused
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    size_t word;
+    for (word = 0; word < EVENT_WORDS; word++)
+        __atomic_store_n (&slot [word], words [word], __ATOMIC_RELAXED);
+    __atomic_store_n (&self->head, self->head + 1, __ATOMIC_RELEASE);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of events held in the ring.
+
+size_t
+zs_trace_size (zs_trace_t *self)
+{
+    uint64_t head = __atomic_load_n (&self->head, __ATOMIC_ACQUIRE);
+    return head > self->mask? self->mask: (size_t) head;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Discard all events in the ring.
+
+void
+zs_trace_purge (zs_trace_t *self)
+{
+    __atomic_store_n (&self->head, 0, __ATOMIC_RELEASE);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Copy up to limit of the newest events out of the ring, oldest first.
+//  This is safe while another thread is recording; events overwritten
+//  during the copy are dropped. Returns number of events copied.
+
+size_t
+zs_trace_snapshot (zs_trace_t *self, zs_trace_event_t *events, size_t limit)
+{
+    uint64_t head = __atomic_load_n (&self->head, __ATOMIC_ACQUIRE);
+    //  We never return the oldest slot, as the recorder may be writing it
+    uint64_t start = head > self->mask? head - self->mask: 0;
+    if (head - start > limit)
+        start = head - limit;
+
+    uint64_t index;
+    for (index = start; index < head; index++) {
+        uint64_t *slot = self->slots + (index & self->mask) * EVENT_WORDS;
+        uint64_t words [EVENT_WORDS];
+        size_t word;
+        for (word = 0; word < EVENT_WORDS; word++)
+            words [word] = __atomic_load_n (&slot [word], __ATOMIC_RELAXED);
+        memcpy (&events [index - start], words, sizeof (zs_trace_event_t));
+    }
+    //  If the recorder has moved on while we were copying, the events it
+    //  may have overwritten are no longer valid
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    uint64_t now = __atomic_load_n (&self->head, __ATOMIC_RELAXED);
+    if (now < head)
+        return 0;               //  Purged while we were copying
+    uint64_t valid = now > self->mask? now - self->mask: 0;
+    if (valid > start) {
+        size_t dropped = valid - start < head - start? valid - start: head - start;
+        memmove (events, events + dropped, (head - start - dropped) * sizeof (zs_trace_event_t));
+        return head - start - dropped;
+    }
+    return head - start;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Print one event as a line of text.
+
+void
+zs_trace_event_print (const zs_trace_event_t *event, const char *name, FILE *file)
+{
+    fprintf (file, "D [%04u]: %*s%s stdin=%u stdout=%u\n",
+             event->needle, event->depth * 2, "", name,
+             event->stdin_size, event->stdout_size);
+}
+
+
+//  Take a snapshot of the whole ring; caller must free it
+static zs_trace_event_t *
+s_snapshot (zs_trace_t *self, size_t *count)
+{
+    size_t limit = self->mask + 1;
+    zs_trace_event_t *events = (zs_trace_event_t *) zmalloc (limit * sizeof (zs_trace_event_t));
+    assert (events);
+    *count = zs_trace_snapshot (self, events, limit);
+    return events;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Print the events in the ring as text, oldest first.
+
+void
+zs_trace_print (zs_trace_t *self, FILE *file, zs_trace_name_fn *namer, void *args)
+{
+    size_t count;
+    zs_trace_event_t *events = s_snapshot (self, &count);
+    size_t index;
+    for (index = 0; index < count; index++) {
+        fprintf (file, "%+10.3f us ",
+                 (events [index].nanos - events [0].nanos) / 1000.0);
+        zs_trace_event_print (&events [index], namer (args, &events [index]), file);
+    }
+    free (events);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Print the events in the ring in Chrome trace event JSON, which you can
+//  load into chrome://tracing or Perfetto. Function calls show as nested
+//  slices, and each other instruction lasts until the next one starts.
+
+void
+zs_trace_print_json (zs_trace_t *self, FILE *file, zs_trace_name_fn *namer, void *args)
+{
+    size_t count;
+    zs_trace_event_t *events = s_snapshot (self, &count);
+    fprintf (file, "{\"traceEvents\":[");
+    size_t index;
+    for (index = 0; index < count; index++) {
+        zs_trace_event_t *event = &events [index];
+        double timestamp = (event->nanos - events [0].nanos) / 1000.0;
+        fprintf (file, "%s\n{\"name\":\"", index? ",": "");
+        //  Names are function and atomic names, but escape them anyway
+        const char *name = namer (args, event);
+        for (; *name; name++) {
+            if (*name == '"' || *name == '\\')
+                fputc ('\\', file);
+            if ((byte) *name >= ' ')
+                fputc (*name, file);
+        }
+        fprintf (file, "\",\"cat\":\"zs\",\"pid\":1,\"tid\":1,\"ts\":%.3f,", timestamp);
+        if (event->kind == zs_trace_call)
+            fprintf (file, "\"ph\":\"B\",");
+        else
+        if (event->kind == zs_trace_return)
+            fprintf (file, "\"ph\":\"E\",");
+        else {
+            double duration = index + 1 < count
+                ? (events [index + 1].nanos - event->nanos) / 1000.0: 0;
+            fprintf (file, "\"ph\":\"X\",\"dur\":%.3f,", duration);
+        }
+        fprintf (file, "\"args\":{\"needle\":%u,\"stdin\":%u,\"stdout\":%u}}",
+                 event->needle, event->stdin_size, event->stdout_size);
+    }
+    fprintf (file, "\n]}\n");
+    free (events);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Selftest
+
+static const char *
+s_test_namer (void *args, const zs_trace_event_t *event)
+{
+    return event->kind == zs_trace_call? "call": "step";
+}
+
+//  Return what was written to a temporary file, as a fresh string
+static char *
+s_read_back (FILE *file)
+{
+    long size = ftell (file);
+    rewind (file);
+    char *buffer = (char *) zmalloc (size + 1);
+    assert (buffer);
+    buffer [fread (buffer, 1, size, file)] = 0;
+    return buffer;
+}
+
+void
+zs_trace_test (bool verbose)
+{
+    printf (" * zs_trace: ");
+    if (verbose)
+        printf ("\n");
+
+    //  @selftest
+    zs_trace_t *trace = zs_trace_new (10);
+    assert (zs_trace_size (trace) == 0);
+
+    //  The ring keeps the newest events, oldest first
+    zs_trace_event_t event = { 0 };
+    uint32_t needle;
+    for (needle = 1; needle <= 100; needle++) {
+        event.nanos = needle * 1000;
+        event.needle = needle;
+        event.kind = needle % 10 == 0? zs_trace_call: zs_trace_step;
+        zs_trace_record (trace, &event);
+    }
+    assert (zs_trace_size (trace) == 15);
+    zs_trace_event_t events [16];
+    assert (zs_trace_snapshot (trace, events, 16) == 15);
+    assert (events [0].needle == 86);
+    assert (events [14].needle == 100);
+    assert (zs_trace_snapshot (trace, events, 4) == 4);
+    assert (events [0].needle == 97);
+
+    //  Dumpers produce one line per event
+    FILE *file = tmpfile ();
+    assert (file);
+    zs_trace_print (trace, file, s_test_namer, NULL);
+    char *buffer = s_read_back (file);
+    fclose (file);
+    size_t lines = 0;
+    char *line;
+    for (line = buffer; *line; line++)
+        lines += *line == '\n';
+    assert (lines == 15);
+    assert (strstr (buffer, "D [0100]: call"));
+    free (buffer);
+
+    file = tmpfile ();
+    assert (file);
+    zs_trace_print_json (trace, file, s_test_namer, NULL);
+    buffer = s_read_back (file);
+    fclose (file);
+    assert (strncmp (buffer, "{\"traceEvents\":[", 16) == 0);
+    assert (strstr (buffer, "\"name\":\"call\""));
+    assert (strstr (buffer, "\"ph\":\"B\""));
+    assert (strstr (buffer, "\"ph\":\"X\",\"dur\":1.000"));
+    free (buffer);
+
+    zs_trace_purge (trace);
+    assert (zs_trace_size (trace) == 0);
+    zs_trace_destroy (&trace);
+    //  @end
+    printf ("OK\n");
+}
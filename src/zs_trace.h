@@ -0,0 +1,105 @@
+/*  =========================================================================
+    zs_trace - ring of binary trace events
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of the ZeroScript language, http://zeroscript.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef ZS_TRACE_H_INCLUDED
+#define ZS_TRACE_H_INCLUDED
+
+#include <czmq.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Opaque class structure
+#ifndef ZS_TRACE_T_DEFINED
+typedef struct _zs_trace_t zs_trace_t;
+#endif
+
+//  Kinds of trace event
+typedef enum {
+    zs_trace_step,                  //  Any other instruction
+    zs_trace_call,                  //  Call to a function
+    zs_trace_return                 //  Return from a function
+} zs_trace_kind_t;
+
+//  One trace event, recorded as each instruction starts
+typedef struct {
+    uint64_t nanos;                 //  Monotonic time, in nanoseconds
+    uint32_t needle;                //  Address of instruction
+    uint32_t address;               //  Function address, for calls
+    uint16_t stdin_size;            //  Values on input pipe
+    uint16_t stdout_size;           //  Values on output pipe
+    byte opcode;                    //  Instruction opcode
+    byte depth;                     //  Call stack depth
+    byte kind;                      //  zs_trace_kind_t
+    byte unused;
+} zs_trace_event_t;
+
+//  Returns a printable name for the event; the dumpers use this to name
+//  opcodes and functions, which only the virtual machine knows.
+typedef const char * (zs_trace_name_fn) (void *args, const zs_trace_event_t *event);
+
+//  @interface
+//  Create a new trace ring that keeps the most recent events. It holds one
+//  less than the smallest power of two above limit, so at least limit
+//  events. Returns the reference if successful, or NULL if construction
+//  failed due to lack of available memory.
+zs_trace_t *
+    zs_trace_new (size_t limit);
+
+//  Destroy the trace ring and free all memory used by it.
+void
+    zs_trace_destroy (zs_trace_t **self_p);
+
+//  Record one event, overwriting the oldest event if the ring is full. Only
+//  one thread may record into a ring.
+void
+    zs_trace_record (zs_trace_t *self, const zs_trace_event_t *event);
+
+//  Return number of events held in the ring.
+size_t
+    zs_trace_size (zs_trace_t *self);
+
+//  Discard all events in the ring.
+void
+    zs_trace_purge (zs_trace_t *self);
+
+//  Copy up to limit of the newest events out of the ring, oldest first.
+//  This is safe while another thread is recording; events overwritten
+//  during the copy are dropped. Returns number of events copied.
+size_t
+    zs_trace_snapshot (zs_trace_t *self, zs_trace_event_t *events, size_t limit);
+
+//  Print one event as a line of text.
+void
+    zs_trace_event_print (const zs_trace_event_t *event, const char *name, FILE *file);
+
+//  Print the events in the ring as text, oldest first.
+void
+    zs_trace_print (zs_trace_t *self, FILE *file, zs_trace_name_fn *namer, void *args);
+
+//  Print the events in the ring in Chrome trace event JSON, which you can
+//  load into chrome://tracing or Perfetto. Function calls show as nested
+//  slices, and each other instruction lasts until the next one starts.
+void
+    zs_trace_print_json (zs_trace_t *self, FILE *file, zs_trace_name_fn *namer, void *args);
+
+//  Self test of this class
+void
+    zs_trace_test (bool verbose);
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,12 +37,22 @@ s_scale_up (zs_pipe_t *input, zs_pipe_t *output, int64_t scale)
 }
 #endif
 
+static int
+s_minutes_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (60LL));
+    return 0;
+}
+
 static int
 s_minutes (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "minutes", zs_type_modest, "Scale by seconds per minute");
         zs_vm_register (self, "minute", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_minutes_whole);
     }
     else {
         //  Process all values on input pipe
@@ -53,12 +63,22 @@ s_minutes (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_hours_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (60LL * 60LL));
+    return 0;
+}
+
 static int
 s_hours (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "hours", zs_type_modest, "Scale by seconds per hour");
         zs_vm_register (self, "hour", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_hours_whole);
     }
     else {
         //  Process all values on input pipe
@@ -69,12 +89,22 @@ s_hours (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_days_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (60LL * 60LL * 24LL));
+    return 0;
+}
+
 static int
 s_days (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "days", zs_type_modest, "Scale by seconds per day");
         zs_vm_register (self, "day", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_days_whole);
     }
     else {
         //  Process all values on input pipe
@@ -85,12 +115,22 @@ s_days (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_weeks_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (60LL * 60LL * 24LL * 7LL));
+    return 0;
+}
+
 static int
 s_weeks (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "weeks", zs_type_modest, "Scale by seconds per week");
         zs_vm_register (self, "week", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_weeks_whole);
     }
     else {
         //  Process all values on input pipe
@@ -101,12 +141,22 @@ s_weeks (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_years_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (60LL * 60LL * 24LL * 365LL));
+    return 0;
+}
+
 static int
 s_years (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "years", zs_type_modest, "Scale by seconds per non-leap year");
         zs_vm_register (self, "year", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_years_whole);
     }
     else {
         //  Process all values on input pipe
@@ -123,6 +173,7 @@ s_msecs (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "msecs", zs_type_modest, "Scale by seconds per 1/1000");
         zs_vm_register (self, "msec", zs_type_modest, NULL);
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -139,6 +190,7 @@ s__minute (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/minute", zs_type_modest, "Scale by minutes per seconds");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -155,6 +207,7 @@ s__hour (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/hour", zs_type_modest, "Scale by hours per second");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -171,6 +224,7 @@ s__day (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/day", zs_type_modest, "Scale by days per second");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -187,6 +241,7 @@ s__week (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/week", zs_type_modest, "Scale by weeks per second");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -203,6 +258,7 @@ s__year (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/year", zs_type_modest, "Scale by non-leap years per second");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -219,6 +275,7 @@ s__msec (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "/msec", zs_type_modest, "Scale by msecs per seconds");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
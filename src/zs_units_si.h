@@ -37,11 +37,21 @@ s_scale_up (zs_pipe_t *input, zs_pipe_t *output, int64_t scale)
 }
 #endif
 
+static int
+s_Ki_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL));
+    return 0;
+}
+
 static int
 s_Ki (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Ki", zs_type_modest, "Scale by 2^10");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Ki_whole);
     }
     else {
         //  Process all values on input pipe
@@ -52,11 +62,21 @@ s_Ki (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_Mi_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL * 1024LL));
+    return 0;
+}
+
 static int
 s_Mi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Mi", zs_type_modest, "Scale by 2^20");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Mi_whole);
     }
     else {
         //  Process all values on input pipe
@@ -67,11 +87,21 @@ s_Mi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_Gi_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL * 1024LL * 1024LL));
+    return 0;
+}
+
 static int
 s_Gi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Gi", zs_type_modest, "Scale by 2^30");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Gi_whole);
     }
     else {
         //  Process all values on input pipe
@@ -82,11 +112,21 @@ s_Gi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_Ti_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL * 1024LL * 1024LL * 1024LL));
+    return 0;
+}
+
 static int
 s_Ti (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Ti", zs_type_modest, "Scale by 2^40");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Ti_whole);
     }
     else {
         //  Process all values on input pipe
@@ -97,11 +137,21 @@ s_Ti (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_Pi_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL * 1024LL * 1024LL * 1024LL * 1024LL));
+    return 0;
+}
+
 static int
 s_Pi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Pi", zs_type_modest, "Scale by 2^50");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Pi_whole);
     }
     else {
         //  Process all values on input pipe
@@ -112,11 +162,21 @@ s_Pi (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_Ei_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1024LL * 1024LL * 1024LL * 1024LL * 1024LL * 1024LL));
+    return 0;
+}
+
 static int
 s_Ei (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Ei", zs_type_modest, "Scale by 2^60");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_Ei_whole);
     }
     else {
         //  Process all values on input pipe
@@ -127,11 +187,21 @@ s_Ei (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_da_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (10));
+    return 0;
+}
+
 static int
 s_da (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "da", zs_type_modest, "Scale by 10");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_da_whole);
     }
     else {
         //  Process all values on input pipe
@@ -142,11 +212,21 @@ s_da (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_h_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (100));
+    return 0;
+}
+
 static int
 s_h (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "h", zs_type_modest, "Scale by 100");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_h_whole);
     }
     else {
         //  Process all values on input pipe
@@ -157,11 +237,21 @@ s_h (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_k_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1000));
+    return 0;
+}
+
 static int
 s_k (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "k", zs_type_modest, "Scale by 1000");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_k_whole);
     }
     else {
         //  Process all values on input pipe
@@ -172,11 +262,21 @@ s_k (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_M_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1000000));
+    return 0;
+}
+
 static int
 s_M (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "M", zs_type_modest, "Scale by 10^6");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_M_whole);
     }
     else {
         //  Process all values on input pipe
@@ -187,11 +287,21 @@ s_M (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_G_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1E9));
+    return 0;
+}
+
 static int
 s_G (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "G", zs_type_modest, "Scale by 10^9");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_G_whole);
     }
     else {
         //  Process all values on input pipe
@@ -202,11 +312,21 @@ s_G (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_T_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1E12));
+    return 0;
+}
+
 static int
 s_T (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "T", zs_type_modest, "Scale by 10^12");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_T_whole);
     }
     else {
         //  Process all values on input pipe
@@ -217,11 +337,21 @@ s_T (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_P_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1E15));
+    return 0;
+}
+
 static int
 s_P (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "P", zs_type_modest, "Scale by 10^15");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_P_whole);
     }
     else {
         //  Process all values on input pipe
@@ -232,11 +362,21 @@ s_P (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
     return 0;
 }
 
+static int
+s_E_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    while (zs_pipe_recv (input))
+        zs_pipe_send_whole (output, zs_pipe_whole (input) * (int64_t) (1E18));
+    return 0;
+}
+
 static int
 s_E (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "E", zs_type_modest, "Scale by 10^18");
+        zs_vm_register_signature (self, "wrs", "wr", ZS_ARITY_EACH, zs_effect_pure);
+        zs_vm_register_whole (self, s_E_whole);
     }
     else {
         //  Process all values on input pipe
@@ -252,6 +392,7 @@ s_Z (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Z", zs_type_modest, "Scale by 10^21");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -268,6 +409,7 @@ s_Y (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "Y", zs_type_modest, "Scale by 10^24");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -284,6 +426,7 @@ s_d (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "d", zs_type_modest, "Scale by 1/10");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -300,6 +443,7 @@ s_c (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "c", zs_type_modest, "Scale by 1/100");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -316,6 +460,7 @@ s_m (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "m", zs_type_modest, "Scale by 1/1000");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -332,6 +477,7 @@ s_u (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "u", zs_type_modest, "Scale by 1/10^6");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -348,6 +494,7 @@ s_n (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "n", zs_type_modest, "Scale by 1/10^9");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -364,6 +511,7 @@ s_p (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "p", zs_type_modest, "Scale by 1/10^12");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -380,6 +528,7 @@ s_f (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "f", zs_type_modest, "Scale by 1/10^15");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -396,6 +545,7 @@ s_a (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "a", zs_type_modest, "Scale by 1/10^18");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -412,6 +562,7 @@ s_z (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "z", zs_type_modest, "Scale by 1/10^21");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -428,6 +579,7 @@ s_y (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
     if (zs_vm_probing (self)) {
         zs_vm_register (self, "y", zs_type_modest, "Scale by 1/10^24");
+        zs_vm_register_signature (self, "wrs", "r", ZS_ARITY_EACH, zs_effect_pure);
     }
     else {
         //  Process all values on input pipe
@@ -23,12 +23,12 @@
     Notes about the virtual machine:
     - token threaded bytecode interpreter
     - machine uses bytecodes with parameters following each opcode
-    - 240-254 are built-in opcodes
+    - 239-254 are built-in opcodes
         - essential to machine operation
         - decoding costs must be minimized
         - handled by if/switch in core interpreter
         - can modify instruction pointer (needle)
-    - 0..239 are class 0 atomics
+    - 0..238 are class 0 atomics
         - no class name (short obvious names)
         - assumed to be most commonly used
         - core runtime for ZeroScript machines
@@ -41,22 +41,69 @@
         - designed to be added dynamically
         - decoding costs are insignificant
 
+    Notes about forking:
+    - a forked VM shares its parent's code and atomics, read-only
+    - its own code continues the parent's address space, in an overlay
+    - the parent's code is frozen while it has forked children
+
+    Notes about execution contexts:
+    - a zs_exec_t holds the pipes and stacks of one run; the VM holds code
+    - many contexts can run one VM's code at once, on their own threads
+    - each VM has its own context, which zs_vm_run uses
+    - atomics get the VM; the atomic API finds the context running on
+      the calling thread
+
+    Notes about inlining:
+    - calls to small functions compile to a copy of the function body
+    - the copy keeps the pipe semantics, since functions don't touch pipes
+    - zs_vm_set_inline sets the size limit, or switches inlining off
+
+    Notes about registers:
+    - number constants wait in a few registers, instead of going to stdout
+    - a pull that wants the last value takes it from a register to stdin
+    - anything else that looks at stdout sends the registers on first
+
+    Notes about specialization:
+    - atomics may register a variant that only handles whole numbers
+    - at commit, a types pass follows values through stdout and nests, and
+      calls the variant where all the atomic's input must be whole
+    - the pass knows nothing at function entry or where paths meet
+    - atomics declare signatures: the value types they take and send, how
+      many values they send, and whether they're pure; the types pass uses
+      these to follow values through atomic calls
+
+    Notes about verification:
+    - each function is verified at commit, before anything can run it
+    - the verifier also works out how deep the stacks can get, and stores
+      that in the function header; runs size the stacks up front
+    - the interpreter trusts verified code, so its checks are only asserts,
+      which release builds (NDEBUG) compile out
+    - the interpreter checks for interrupts only at safepoints (calls and
+      backward jumps); the verifier makes sure loops can't go back otherwise
+    - code that fails verification is a compiler bug; the commit fails,
+      and the caller rolls the function back
+
+    Notes about tracing:
+    - a context can keep its last instructions in a binary trace ring
+    - if the process aborts, as on a failed assertion, while a context with
+      a trace ring runs on that thread, we print the ring to stderr first
+
+    Notes about parallel execution:
+    - pmap and parallel {} loops run code on worker contexts, one per thread
+    - inside a worker context, further parallel work runs on the same thread
+    - atomics in parallel work must not change the shared VM; tracing and
+      profiling state lives in each context, and connect fails in workers
+
     Current limitations:
         - max VM code size is 2^24 (3-byte addresses)
         - max size of a single function is 64k (2-byte offsets)
-        - max nesting depth is 256 (asserted)
-        - max output stack nesting is 256 (asserted)
-        - max function call depth is 256 (asserted)
+        - stacks for nesting, loops and calls are sized per run, from nothing
+        - nesting, loop, and call depths are at most 2^24 per function
 @end
 */
 
-#define MAX_SCOPE   256     //  Nesting limit at compile time
-#define MAX_NEST    256     //  Maximum nest () depth
-#define MAX_LOOP    256     //  Maximum loop {} depth
-#define MAX_CALLS   256     //  Maximum function call depth
-
 //  Bytecodes
-//  - up to 240 class 0 dictionary
+//  - up to 239 class 0 dictionary
 //  - 255 + 16 bits = extensions; class (1..n) + function numbe
 
 //  These are built-in opcodes which are allowed to modify the needle, so we
@@ -73,8 +120,11 @@
 #define VM_STRING       246     //  Issue a string constant
 #define VM_PIPE         245     //  Execute pipe operation
 #define VM_SENTENCE     244     //  End sentence
+#define VM_PLOOP        243     //  Run parallel loop
+#define VM_XPLOOP       242     //  End of parallel loop body
 #define VM_GUARD        241     //  Assert if we ever reach this
-#define VM_STOP         240     //  Last built-in
+#define VM_STOP         240     //  Stop the machine
+#define VM_CONSTANTS    239     //  Issue a run of constants; last built-in
 
 //  These are the pipe operations, managing output and input pipes so that
 //  functions what they need. The pipe operation is always compiled after a
@@ -88,6 +138,10 @@
 #define VM_PIPE_UNLOOP  7       //  Prepare to call loop function
 #define VM_PIPE_MARK    8       //  End phrase
 
+//  Function bodies up to this many bytes are copied into their callers,
+//  instead of being called. That covers wrappers like K: (1000 *).
+#define INLINE_MAX      32
+
 static const char *
 pipe_op_name [] = {
     "?", "NEST", "UNNEST", "SINGLE", "MODEST", "GREEDY", "ARRAY", "UNLOOP", "MARK"
@@ -95,6 +149,19 @@ pipe_op_name [] = {
 
 #include "zs_classes.h"
 
+//  Make room for one more item on a stack that holds used items, growing
+//  it as needed; stacks start empty, so idle VMs cost little memory
+static void *
+s_stack_reserve (void *stack, size_t *max_p, size_t used, size_t item_size)
+{
+    if (used == *max_p) {
+        *max_p = *max_p? *max_p * 2: 16;
+        stack = realloc (stack, *max_p * item_size);
+        assert (stack);
+    }
+    return stack;
+}
+
 //  Work with atomics
 
 typedef struct {
@@ -102,6 +169,12 @@ typedef struct {
     char *name;                     //  Primitive name
     char *hint;                     //  Hint to user
     zs_type_t type;                 //  Function type
+    char input [4];                 //  Value types it takes
+    char output [4];                //  Value types it sends
+    int arity;                      //  Values it sends
+    zs_effect_t effect;             //  What else it does
+    byte whole;                     //  Variant for wholes, if any
+    byte generic;                   //  If a variant, the atomic it stands for
 } s_atomic_t;
 
 static s_atomic_t *
@@ -113,6 +186,11 @@ s_atomic_new (zs_vm_fn_t *function, const char *name, zs_type_t type, const char
     self->name = strdup (name);
     self->hint = strdup (hint);
     self->type = type;
+    //  Until told otherwise, the atomic could do anything
+    strcpy (self->input, "wrs");
+    strcpy (self->output, "wrs");
+    self->arity = ZS_ARITY_ANY;
+    self->effect = zs_effect_writes;
     return self;
 }
 
@@ -127,11 +205,145 @@ s_atomic_destroy (s_atomic_t **self_p)
     }
 }
 
+//  Named output ring, for connecting VMs across threads
+
+typedef struct {
+    char *name;                     //  Port name
+    zs_ring_t *ring;                //  Ring, not owned by us
+} s_port_t;
+
+static void
+s_port_destroy (s_port_t **self_p)
+{
+    s_port_t *self = *self_p;
+    if (self) {
+        free (self->name);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  Execution profile, collected while profiling is enabled. Atomics are
+//  timed on their own; user functions include the time of their callees.
+
+typedef struct {
+    char *name;                     //  Atomic or function name
+    size_t address;                 //  Function address, zero if free
+    uint64_t calls;                 //  Number of calls
+    uint64_t nanos;                 //  Total time in nanoseconds
+} s_counter_t;
+
+typedef struct {
+    s_counter_t atomics [240];      //  Atomics, by opcode
+    s_counter_t *functions;         //  Hash table of user functions
+    size_t functions_max;           //  Table size, a power of two
+    size_t nbr_functions;           //  Number of functions in table
+    //  Frame zero is the function zs_vm_run called; calls made from
+    //  call stack depth N are timed in frame N + 1
+    size_t *frame_address;          //  Function called at each depth
+    uint64_t *frame_started;        //  When it was called
+    size_t frames_max;              //  Allocated size of frame arrays
+    s_counter_t **sorted;           //  Snapshot, for profile_first/next
+    size_t nbr_sorted;              //  Number of entries in snapshot
+    size_t cursor;                  //  Current entry in snapshot
+} s_profile_t;
+
+static s_profile_t *
+s_profile_new (void)
+{
+    s_profile_t *self = (s_profile_t *) zmalloc (sizeof (s_profile_t));
+    assert (self);
+    self->functions_max = 64;
+    self->functions = (s_counter_t *) zmalloc (self->functions_max * sizeof (s_counter_t));
+    assert (self->functions);
+    return self;
+}
+
+static void
+s_profile_destroy (s_profile_t **self_p)
+{
+    s_profile_t *self = *self_p;
+    if (self) {
+        size_t index;
+        for (index = 0; index < 240; index++)
+            free (self->atomics [index].name);
+        for (index = 0; index < self->functions_max; index++)
+            free (self->functions [index].name);
+        free (self->functions);
+        free (self->frame_address);
+        free (self->frame_started);
+        free (self->sorted);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  Return counter for function address, creating it if needed
+static s_counter_t *
+s_profile_function (s_profile_t *self, size_t address)
+{
+    //  Keep the table at most half full
+    if (self->nbr_functions * 2 >= self->functions_max) {
+        s_counter_t *old_table = self->functions;
+        size_t old_max = self->functions_max;
+        self->functions_max *= 2;
+        self->functions = (s_counter_t *) zmalloc (self->functions_max * sizeof (s_counter_t));
+        assert (self->functions);
+        size_t index;
+        for (index = 0; index < old_max; index++) {
+            if (old_table [index].address) {
+                size_t slot = old_table [index].address & (self->functions_max - 1);
+                while (self->functions [slot].address)
+                    slot = (slot + 1) & (self->functions_max - 1);
+                self->functions [slot] = old_table [index];
+            }
+        }
+        free (old_table);
+    }
+    size_t slot = address & (self->functions_max - 1);
+    while (self->functions [slot].address && self->functions [slot].address != address)
+        slot = (slot + 1) & (self->functions_max - 1);
+    if (!self->functions [slot].address) {
+        self->functions [slot].address = address;
+        self->nbr_functions++;
+    }
+    return &self->functions [slot];
+}
+
+//  Start timing a call in the given frame
+static void
+s_profile_frame (s_profile_t *self, size_t frame, size_t address, uint64_t started)
+{
+    if (frame >= self->frames_max) {
+        size_t frames_max = self->frames_max;
+        while (frame >= frames_max)
+            frames_max = frames_max? frames_max * 2: 16;
+        self->frame_address = (size_t *) realloc (self->frame_address, frames_max * sizeof (size_t));
+        self->frame_started = (uint64_t *) realloc (self->frame_started, frames_max * sizeof (uint64_t));
+        assert (self->frame_address && self->frame_started);
+        memset (self->frame_address + self->frames_max, 0,
+                (frames_max - self->frames_max) * sizeof (size_t));
+        self->frames_max = frames_max;
+    }
+    self->frame_address [frame] = address;
+    self->frame_started [frame] = started;
+}
+
+//  Return monotonic time in nanoseconds
+static uint64_t
+s_now (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
 //  Structure of our class
 
 struct _zs_vm_t {
-    s_atomic_t *atomics [240];      //  Class 0 atomics
+    s_atomic_t **atomics;           //  Class 0 atomics, up to 239
     size_t nbr_atomics;             //  Nbr of atomics defined so far
+    size_t atomics_max;             //  Allocated size, 0 if parent's table
     zs_vm_fn_t *probing;            //  Primitive during registration
 
     byte *code;                     //  Compiled bytecode (zchunk?)
@@ -140,45 +352,164 @@ struct _zs_vm_t {
     size_t code_head;               //  Last defined function
     size_t checkpoint;              //  When defining a function
 
+    //  A forked VM holds only its own code, which starts at code_base, and
+    //  shares all lower addresses, and its first atomics, with its parent
+    zs_vm_t *parent;                //  Parent VM, if forked
+    size_t code_base;               //  Address of first byte in code
+    size_t nbr_shared;              //  Atomics owned by parent
+    size_t nbr_forks;               //  Children sharing our code
+
     //  We use this during compile time to match start/end scopes
-    size_t scope_stack [MAX_SCOPE]; //  Scope stack, arbitrary size
+    size_t *scope_stack;            //  Scope stack, grows as needed
     size_t scope_stack_ptr;         //  Size of scope stack
+    size_t scope_stack_max;         //  Allocated size of scope stack
+
+    zs_exec_t *exec;                //  Our own execution context
+    zlistx_t *ports;                //  Output ports we can connect to
+    size_t workers;                 //  Pool size, zero means one per CPU
+    size_t inline_max;              //  Largest body we inline, in bytes
+    bool tail_calls;                //  Compile trailing calls as jumps
+    bool peephole;                  //  Clean up code at commit
+    bool specialize;                //  Call typed variants of atomics
+    bool verbose;                   //  Trace compilation and execution
+    size_t iterator;                //  For listing functions & atomics
+    bool userspace;                 //  True when iterating functions
+};
+
+//  A number constant that the interpreter holds back from stdout, in case
+//  the next pull takes it straight to stdin
+#define REGISTERS       4
+
+typedef struct {
+    char type;                      //  'w' or 'r'
+    int64_t whole;
+    double real;
+} s_register_t;
+
+//  An execution context holds everything that changes while code runs, so
+//  that many contexts can run the code of one VM at once, on their own
+//  threads. The VM is read-only while it runs.
+
+struct _zs_exec_t {
+    zs_vm_t *vm;                    //  The code we run
 
     //  The nest stack holds output pipes during nested calls
-    zs_pipe_t *nest_stack [MAX_NEST];
+    zs_pipe_t **nest_stack;
     size_t nest_stack_ptr;
+    size_t nest_stack_max;
 
     //  The loop stack holds input pipes during loop cycles
-    //  The indices table matches the stack and holds index values
-    zs_pipe_t *loop_stack [MAX_LOOP];
-    size_t loop_indices [MAX_LOOP];
+    zs_pipe_t **loop_stack;
     size_t loop_stack_ptr;
+    size_t loop_stack_max;
 
     //  The call stack is used for actual function calls
-    size_t call_stack [MAX_CALLS];
+    size_t *call_stack;
     size_t call_stack_ptr;
+    size_t call_stack_max;
 
     zs_pipe_t *stdin;               //  Input to next function
     zs_pipe_t *stdout;              //  Current phrase output
     zs_pipe_t *loopin;              //  Input to next loop function
+    s_register_t registers [REGISTERS];
+    size_t nbr_registers;           //  Constants not yet sent to stdout
     char *results;                  //  Sentence results, if any
+    zs_ring_t *input;               //  Input sentences, if any
+    zs_ring_t *output;              //  Output sentences, if connected
     bool loop_fn;                   //  Call as loop function
 
-    bool verbose;                   //  Trace execution progress
+    zs_pool_t *pool;                //  Worker threads, created on demand
+    zs_exec_t **clones;             //  Worker contexts, one per pool slot
+    size_t nbr_clones;              //  Number of worker contexts
+    bool worker;                    //  Runs parallel work in place
+
+    bool verbose;                   //  Print each instruction as it runs
     bool debug;                     //  Trace pipe states during execution
-    size_t iterator;                //  For listing functions & atomics
-    bool userspace;                 //  True when iterating functions
+    bool tracing;                   //  Any kind of tracing
+    zs_trace_t *trace;              //  Trace ring, if any
+    bool profiling;                 //  Collect execution profile
+    s_profile_t *profile;           //  Profile, kept after profiling ends
 };
 
+//  The context executing on this thread, if any. Atomics get the VM, and
+//  the atomic API uses this to find the context they are running in.
+static __thread zs_exec_t *s_running;
+
+//  Return the context an atomic API call applies to: the one running the
+//  VM's code on this thread, else the VM's own context
+static zs_exec_t *
+s_exec (zs_vm_t *self)
+{
+    if (s_running && s_running->vm == self)
+        return s_running;
+    return self->exec;
+}
+
+//  Any kind of tracing slows down the interpreter
+static void
+s_exec_set_tracing (zs_exec_t *self)
+{
+    self->tracing = self->vm->verbose || self->verbose || self->debug || self->trace;
+}
+
+//  Map code address to memory; lower addresses in a forked VM belong to its
+//  parent, or grandparent, and so on
+static inline byte *
+s_code (zs_vm_t *self, size_t address)
+{
+    while (address < self->code_base)
+        self = self->parent;
+    return self->code + (address - self->code_base);
+}
+
+//  Append data to our code, growing the code buffer as needed
+static void
+s_emit_data (zs_vm_t *self, const void *data, size_t size)
+{
+    size_t used = self->code_size - self->code_base;
+    if (used + size > self->code_max) {
+        while (used + size > self->code_max)
+            self->code_max *= 2;
+        self->code = (byte *) realloc (self->code, self->code_max);
+        assert (self->code);
+    }
+    memcpy (self->code + used, data, size);
+    self->code_size += size;
+    //  Addresses are stored in three bytes
+    assert (self->code_size < (1 << 24));
+}
+
+static void
+s_emit (zs_vm_t *self, byte opcode)
+{
+    s_emit_data (self, &opcode, 1);
+}
+
+//  Stack depths a function needs to run, counting the functions it calls.
+//  The verifier works these out, and stores them in the function header,
+//  after the name, as three 3-byte values.
+typedef struct {
+    size_t calls;                   //  Call frames, beyond the caller's
+    size_t nests;                   //  Nested calls open at once
+    size_t loops;                   //  Loops open at once
+} s_needs_t;
+
+#define NEEDS_SIZE      9
+
+//  Map function address to its stack needs, in the header
+static size_t
+s_function_needs_at (zs_vm_t *self, size_t address)
+{
+    assert (address);
+    return address + 3 + strlen ((char *) s_code (self, address + 3)) + 1;
+}
+
 //  Map function address to code body
 static size_t
 s_function_body (zs_vm_t *self, size_t address)
 {
-    if (address) {
-        size_t body = address + 3;
-        body += strlen ((char *) self->code + body) + 1;
-        return body;
-    }
+    if (address)
+        return s_function_needs_at (self, address) + NEEDS_SIZE;
     else
         return 0;
 }
@@ -188,7 +519,7 @@ static const char *
 s_function_name (zs_vm_t *self, size_t address)
 {
     if (address)
-        return (const char *) self->code + address + 3;
+        return (const char *) s_code (self, address + 3);
     else
         return "";
 }
@@ -207,16 +538,17 @@ s_resolve (zs_vm_t *self, const char *name)
     //  Look for a user-defined function from newest to oldest
     size_t address = self->code_head;
     while (address) {
-        assert (self->code [address] == VM_GUARD);
+        assert (*s_code (self, address) == VM_GUARD);
         if (streq (name, s_function_name (self, address)))
             return (VM_CALL << 24) + address;
-        size_t offset = (self->code [address + 1] << 8) + self->code [address + 2];
+        size_t offset = (*s_code (self, address + 1) << 8) + *s_code (self, address + 2);
         assert (address >= offset);
         address -= offset;
     }
     //  Look for a class zero atomic
     for (address = 0; address < self->nbr_atomics; address++)
-        if (streq ((self->atomics [address])->name, name))
+        if (streq ((self->atomics [address])->name, name)
+        &&  !(self->atomics [address])->generic)
             return address;
 
     //  Look for a built-in
@@ -227,25 +559,139 @@ s_resolve (zs_vm_t *self, const char *name)
 }
 
 
-//  Compile call to function, atomic, or built-in
+//  Push an address onto the compile-time scope stack
+static void
+s_scope_push (zs_vm_t *self, size_t address)
+{
+    self->scope_stack = (size_t *) s_stack_reserve (self->scope_stack,
+        &self->scope_stack_max, self->scope_stack_ptr, sizeof (size_t));
+    self->scope_stack [self->scope_stack_ptr++] = address;
+}
+
+
+//  Decode 3-byte address stored in code
+static size_t
+s_decode_address (byte *code)
+{
+    return (size_t) (code [0] << 16) + (size_t) (code [1] << 8) + (size_t) (code [2]);
+}
+
+//  Encode 3-byte address into code
+static void
+s_encode_address (byte *code, size_t address)
+{
+    code [0] = (byte) (address >> 16);
+    code [1] = (byte) (address >> 8);
+    code [2] = (byte) (address);
+}
+
+//  True if the opcode is followed by an address to jump to
+static bool
+s_is_jump (byte opcode)
+{
+    return opcode == VM_LOOP || opcode == VM_PLOOP || opcode == VM_XLOOP
+        || opcode == VM_JUMP || opcode == VM_JUMPEX;
+}
+
+
+//  Return size of the instruction at this address, in bytes
+
+static size_t
+s_instruction_size (const byte *code)
+{
+    switch (*code) {
+        case VM_CALL:
+        case VM_LOOP:
+        case VM_PLOOP:
+        case VM_XLOOP:
+        case VM_JUMP:
+        case VM_JUMPEX:
+            return 4;
+        case VM_WHOLE:
+        case VM_REAL:
+            return 9;
+        case VM_STRING:
+            return 2 + strlen ((const char *) code + 1);
+        case VM_PIPE:
+            return 2;
+        case VM_CONSTANTS: {
+            //  Count, then that many constant instructions
+            size_t size = 2;
+            size_t count = code [1];
+            while (count--)
+                size += s_instruction_size (code + size);
+            return size;
+        }
+        default:
+            return 1;
+    }
+}
+
+//  Copy the body of a small function into the current function instead of
+//  calling it. The body cannot call itself, since names resolve to earlier
+//  definitions while we compile. Its loop and jump addresses point into the
+//  body, so we move them along with it. Returns true if we inlined the body,
+//  false if it was too large.
+
+static bool
+s_compile_inlined (zs_vm_t *self, size_t address)
+{
+    if (!self->inline_max)
+        return false;           //  Inlining is switched off
+    size_t body = s_function_body (self, address);
+    //  A body lies wholly in the code of one VM, parent or child
+    const byte *code = s_code (self, body);
+    size_t size = 0;
+    while (code [size] != VM_RETURN) {
+        //  Tail calls, and jumps threaded through them, leave the body; they
+        //  only work from the end of the function
+        if (s_is_jump (code [size]) && s_decode_address ((byte *) code + size + 1) < body)
+            return false;
+        size += s_instruction_size (code + size);
+        if (size > self->inline_max)
+            return false;
+    }
+    //  Copy first, as the body may be in our own code, which can move
+    byte *copy = (byte *) malloc (size? size: 1);
+    assert (copy);
+    memcpy (copy, code, size);
+    size_t target = self->code_size;
+    size_t offset;
+    for (offset = 0; offset < size; offset += s_instruction_size (copy + offset)) {
+        if (s_is_jump (copy [offset])) {
+            size_t jump = s_decode_address (copy + offset + 1);
+            assert (jump >= body && jump <= body + size);
+            s_encode_address (copy + offset + 1, jump - body + target);
+        }
+    }
+    s_emit_data (self, copy, size);
+    free (copy);
+    return true;
+}
+
+//  Compile call to function, atomic, or built-in; small functions are
+//  inlined instead of called
 
 static void
 s_compile_call (zs_vm_t *self, size_t address, byte pipe_op)
 {
     //  A non-zero pipe_op means we muck with the plumbing
     if (pipe_op) {
-        self->code [self->code_size++] = VM_PIPE;
-        self->code [self->code_size++] = pipe_op;
+        s_emit (self, VM_PIPE);
+        s_emit (self, pipe_op);
     }
     if (address < 256)
-        self->code [self->code_size++] = (byte) address;
+        s_emit (self, (byte) address);
+    else
+    if (s_compile_inlined (self, address & 0xFFFFFF))
+        ;                       //  Body copied in place of the call
     else {
         //  Store 4 bytes from high to low
-        self->code [self->code_size++] = (byte) (address >> 24);
-        self->code [self->code_size++] = (byte) (address >> 16);
-        self->code [self->code_size++] = (byte) (address >> 8);
-        self->code [self->code_size++] = (byte) (address);
-        assert (self->code [self->code_size - 4] == VM_CALL);
+        s_emit (self, (byte) (address >> 24));
+        s_emit (self, (byte) (address >> 16));
+        s_emit (self, (byte) (address >> 8));
+        s_emit (self, (byte) (address));
+        assert (*s_code (self, self->code_size - 4) == VM_CALL);
     }
 }
 
@@ -255,8 +701,10 @@ s_compile_call (zs_vm_t *self, size_t address, byte pipe_op)
 static int
 s_halt_error (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 {
-    if (zs_vm_probing (self))
+    if (zs_vm_probing (self)) {
         zs_vm_register (self, "$halt$", zs_type_nullary, "Halt on error");
+        zs_vm_register_signature (self, "", "", 0, zs_effect_writes);
+    }
     else {
         printf ("E: tried to execute zero opcode, halting\n");
         return -1;
@@ -265,6 +713,41 @@ s_halt_error (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
 }
 
 
+//  This is the parallel {} loop function. It works like times, and the
+//  compiler turns its loops into parallel loops, which run their bodies
+//  on worker threads.
+
+static int
+s_parallel (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "parallel", zs_type_modest, "Loop N times, in parallel");
+        zs_vm_register_signature (self, "w", "w", ZS_ARITY_ANY, zs_effect_pure);
+    }
+    else {
+        int64_t cycles = zs_pipe_recv_whole (input);
+        zs_pipe_mark (output);
+        if (cycles > 0) {
+            //  Send loop event 1 = run loop
+            zs_pipe_send_whole (output, 1);
+            //  Send loop state: number of iterations
+            zs_pipe_send_whole (output, cycles);
+        }
+        else
+            //  Send loop event 0 = skip loop
+            zs_pipe_send_whole (output, 0);
+    }
+    return 0;
+}
+
+//  Return true if the address is the parallel loop function
+static bool
+s_is_parallel (zs_vm_t *self, size_t address)
+{
+    return address < 256 && self->atomics [address]->function == s_parallel;
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Create a new empty virtual machine. Returns the reference if successful,
 //  or NULL if construction failed due to lack of available memory.
@@ -274,13 +757,18 @@ zs_vm_new (void)
 {
     zs_vm_t *self = (zs_vm_t *) zmalloc (sizeof (zs_vm_t));
     if (self) {
-        self->stdin = zs_pipe_new ();
-        self->stdout = zs_pipe_new ();
-        self->loopin = zs_pipe_new ();
-        self->code_max = 32000;         //  Arbitrary; TODO: extensible
+        self->exec = zs_exec_new (self);
+        self->ports = zlistx_new ();
+        zlistx_set_destructor (self->ports, (czmq_destructor *) s_port_destroy);
+        self->code_max = 32000;         //  Arbitrary; grows as needed
         self->code = (byte *) malloc (self->code_max);
-        self->code [self->code_size++] = VM_STOP;
+        self->inline_max = INLINE_MAX;
+        self->tail_calls = true;
+        self->peephole = true;
+        self->specialize = true;
+        s_emit (self, VM_STOP);
         zs_vm_probe (self, s_halt_error);
+        zs_vm_probe (self, s_parallel);
     }
     return self;
 }
@@ -295,19 +783,62 @@ zs_vm_destroy (zs_vm_t **self_p)
     assert (self_p);
     if (*self_p) {
         zs_vm_t *self = *self_p;
-        zstr_free (&self->results);
-        zs_pipe_destroy (&self->stdin);
-        zs_pipe_destroy (&self->stdout);
-        zs_pipe_destroy (&self->loopin);
-        while (self->nbr_atomics)
+        //  Children must go before their parent
+        assert (!__atomic_load_n (&self->nbr_forks, __ATOMIC_SEQ_CST));
+        zs_exec_destroy (&self->exec);
+        zlistx_destroy (&self->ports);
+        while (self->nbr_atomics > self->nbr_shared)
             s_atomic_destroy (&self->atomics [--self->nbr_atomics]);
+        if (self->atomics_max)
+            free (self->atomics);
+        free (self->scope_stack);
         free (self->code);
+        if (self->parent)
+            __atomic_sub_fetch (&self->parent->nbr_forks, 1, __ATOMIC_SEQ_CST);
         free (self);
         *self_p = NULL;
     }
 }
 
 
+//  ---------------------------------------------------------------------------
+//  Create a child VM that shares this VM's compiled code and atomics, read
+//  only. The child compiles its own functions into a private overlay, which
+//  continues the parent's address space, and resolves names there first.
+//  The parent must not compile, roll back, or be destroyed while it has
+//  children; it may fork and run from many threads. Returns the reference if
+//  successful, or NULL if construction failed due to lack of memory.
+
+zs_vm_t *
+zs_vm_fork (zs_vm_t *self)
+{
+    assert (!self->checkpoint);
+    zs_vm_t *child = (zs_vm_t *) zmalloc (sizeof (zs_vm_t));
+    if (child) {
+        child->exec = zs_exec_new (child);
+        child->ports = zlistx_new ();
+        zlistx_set_destructor (child->ports, (czmq_destructor *) s_port_destroy);
+        child->code_max = 1024;         //  Sessions are mostly small
+        child->code = (byte *) malloc (child->code_max);
+        child->code_base = self->code_size;
+        child->code_size = self->code_size;
+        child->code_head = self->code_head;
+        child->parent = self;
+        //  We use our parent's table until we register atomics of our own
+        child->atomics = self->atomics;
+        child->nbr_atomics = self->nbr_atomics;
+        child->nbr_shared = self->nbr_atomics;
+        child->workers = self->workers;
+        child->inline_max = self->inline_max;
+        child->tail_calls = self->tail_calls;
+        child->peephole = self->peephole;
+        child->specialize = self->specialize;
+        __atomic_add_fetch (&self->nbr_forks, 1, __ATOMIC_SEQ_CST);
+    }
+    return child;
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Probe atomic to ask it to register itself; we use a self-registration
 //  system where all information about an atomic is encapsulated in its
@@ -347,12 +878,115 @@ zs_vm_register (zs_vm_t *self, const char *name, zs_type_t type, const char *hin
     assert (hint || self->nbr_atomics);
     if (hint == NULL)
         hint = self->atomics [self->nbr_atomics - 1]->hint;
-    assert (self->nbr_atomics < 240);
+    assert (self->nbr_atomics < VM_CONSTANTS);
+    if (self->atomics_max == 0 && self->nbr_atomics) {
+        //  Copy our parent's table before we change it
+        s_atomic_t **atomics = (s_atomic_t **) malloc (self->nbr_atomics * sizeof (s_atomic_t *));
+        assert (atomics);
+        memcpy (atomics, self->atomics, self->nbr_atomics * sizeof (s_atomic_t *));
+        self->atomics = atomics;
+        self->atomics_max = self->nbr_atomics;
+    }
+    self->atomics = (s_atomic_t **) s_stack_reserve (self->atomics,
+        &self->atomics_max, self->nbr_atomics, sizeof (s_atomic_t *));
     self->atomics [self->nbr_atomics++] = s_atomic_new (self->probing, name, type, hint);
     return 0;
 }
 
 
+//  Return the first atomic the primitive we're probing registered
+static size_t
+s_probed_first (zs_vm_t *self)
+{
+    assert (self->probing);
+    assert (self->nbr_atomics
+        &&  self->atomics [self->nbr_atomics - 1]->function == self->probing);
+    size_t first = self->nbr_atomics - 1;
+    while (first > 0 && self->atomics [first - 1]->function == self->probing)
+        first--;
+    return first;
+}
+
+//  Return true if the string is a valid set of value types
+static bool
+s_valid_types (const char *types)
+{
+    return strlen (types) <= 3 && strspn (types, "wrs") == strlen (types);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Primitive declares its signature, after zs_vm_register and before any
+//  zs_vm_register_whole. This is only valid if zs_vm_probing () is true.
+//  Input and output are the value types it takes and sends, as a string of
+//  'w', 'r', and 's'. Arity is how many values it sends, or ZS_ARITY_EACH,
+//  or ZS_ARITY_ANY. A primitive that doesn't declare a signature takes and
+//  sends any type, has any arity, and writes. Nullary primitives take no
+//  input, so their input must be empty. The signature applies to every name
+//  the primitive registered. Returns 0 if the signature is valid, -1 if not.
+
+int
+zs_vm_register_signature (zs_vm_t *self, const char *input, const char *output,
+                          int arity, zs_effect_t effect)
+{
+    assert (input && output);
+    if (!s_valid_types (input) || !s_valid_types (output) || arity < ZS_ARITY_ANY)
+        return -1;
+    size_t index;
+    for (index = s_probed_first (self); index < self->nbr_atomics; index++)
+        if (self->atomics [index]->type == zs_type_nullary && *input)
+            return -1;
+    for (index = s_probed_first (self); index < self->nbr_atomics; index++) {
+        s_atomic_t *atomic = self->atomics [index];
+        strcpy (atomic->input, input);
+        strcpy (atomic->output, output);
+        atomic->arity = arity;
+        atomic->effect = effect;
+    }
+    return 0;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Primitive registers a variant of itself that only handles whole numbers.
+//  This is only valid if zs_vm_probing () is true, after zs_vm_register. When
+//  the compiler can prove that all input values are whole, it calls the
+//  variant instead. Given only whole numbers, the variant must do what the
+//  primitive does, consume all its input, and send only whole numbers. The
+//  variant applies to every name the primitive registered, and has the
+//  primitive's signature, for whole numbers. Returns 0 if registration
+//  worked, -1 if it failed due to an internal error.
+
+int
+zs_vm_register_whole (zs_vm_t *self, zs_vm_fn_t *variant)
+{
+    size_t first = s_probed_first (self);
+
+    //  The variant is an atomic of its own, which we don't list
+    s_atomic_t *atomic = self->atomics [first];
+    char *name = zsys_sprintf ("%s:whole", atomic->name);
+    zs_vm_fn_t *probing = self->probing;
+    self->probing = variant;
+    int rc = zs_vm_register (self, name, atomic->type, atomic->hint);
+    self->probing = probing;
+    zstr_free (&name);
+    if (rc)
+        return rc;
+
+    size_t opcode = self->nbr_atomics - 1;
+    s_atomic_t *whole = self->atomics [opcode];
+    whole->generic = (byte) first;
+    strcpy (whole->input, "w");
+    strcpy (whole->output, "w");
+    whole->arity = atomic->arity;
+    whole->effect = atomic->effect;
+    size_t index;
+    for (index = first; index < opcode; index++)
+        self->atomics [index]->whole = (byte) opcode;
+    return rc;
+}
+
+
 //  ---------------------------------------------------------------------------
 //  Compile a whole number constant into the virtual machine.
 //  Whole numbers are stored thus:
@@ -361,9 +995,8 @@ zs_vm_register (zs_vm_t *self, const char *name, zs_type_t type, const char *hin
 void
 zs_vm_compile_whole (zs_vm_t *self, int64_t whole)
 {
-    self->code [self->code_size++] = VM_WHOLE;
-    memcpy (self->code + self->code_size, &whole, sizeof (whole));
-    self->code_size += sizeof (whole);
+    s_emit (self, VM_WHOLE);
+    s_emit_data (self, &whole, sizeof (whole));
 }
 
 
@@ -375,9 +1008,8 @@ zs_vm_compile_whole (zs_vm_t *self, int64_t whole)
 void
 zs_vm_compile_real (zs_vm_t *self, double real)
 {
-    self->code [self->code_size++] = VM_REAL;
-    memcpy (self->code + self->code_size, &real, sizeof (real));
-    self->code_size += sizeof (real);
+    s_emit (self, VM_REAL);
+    s_emit_data (self, &real, sizeof (real));
 }
 
 
@@ -389,9 +1021,20 @@ zs_vm_compile_real (zs_vm_t *self, double real)
 void
 zs_vm_compile_string (zs_vm_t *self, const char *string)
 {
-    self->code [self->code_size++] = VM_STRING;
-    strcpy ((char *) self->code + self->code_size, string);
-    self->code_size += strlen (string) + 1;
+    zs_vm_compile_slice (self, string, strlen (string));
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Compile a string constant of the given size into the virtual machine;
+//  the string does not need to be null-terminated.
+
+void
+zs_vm_compile_slice (zs_vm_t *self, const char *string, size_t size)
+{
+    s_emit (self, VM_STRING);
+    s_emit_data (self, string, size);
+    s_emit (self, 0);
 }
 
 
@@ -401,6 +1044,7 @@ zs_vm_compile_string (zs_vm_t *self, const char *string)
 //      [VM_GUARD]                  <-- self->code_head
 //      [offset]                    Offset to previous, hi/lo 2 bytes
 //      [name, null-terminated]
+//      [needs]                     Stack depths, 3 x 3 bytes, set at commit
 //      [ ... ]                     code
 //      [VM_RETURN]
 
@@ -408,78 +1052,754 @@ void
 zs_vm_compile_define (zs_vm_t *self, const char *name)
 {
     assert (!self->checkpoint);
+    //  Our code is frozen while forked children share it
+    assert (!__atomic_load_n (&self->nbr_forks, __ATOMIC_SEQ_CST));
     //  This is provisional on a successful commit
     self->checkpoint = self->code_size;
     //  Store offset to previous function guard, if any
+    assert (self->code_size - self->code_head <= 0xFFFF);
     uint16_t offset = self->code_size - self->code_head;
-    self->code [self->code_size++] = VM_GUARD;
-    self->code [self->code_size++] = (byte) (offset >> 8);
-    self->code [self->code_size++] = (byte) (offset & 0xFF);
+    s_emit (self, VM_GUARD);
+    s_emit (self, (byte) (offset >> 8));
+    s_emit (self, (byte) (offset & 0xFF));
     //  Store function name and bump code size
-    strcpy ((char *) self->code + self->code_size, name);
-    self->code_size += strlen (name) + 1;
+    s_emit_data (self, name, strlen (name) + 1);
+    //  Leave room for the stack needs, which we know once we've verified
+    byte needs [NEEDS_SIZE] = { 0 };
+    s_emit_data (self, needs, NEEDS_SIZE);
 }
 
 
-//  ---------------------------------------------------------------------------
-//  Close the current function definition.
+//  If the function we're compiling ends by calling another, turn that call
+//  into a jump to the callee's body. The callee then returns straight to
+//  our caller, and chains of such calls run in constant stack. The RETURN
+//  stays after the jump, for menus that jump to the end of the function.
 
-void
-zs_vm_commit (zs_vm_t *self)
+static void
+s_compile_tail_call (zs_vm_t *self)
 {
-    //  We must have an open function definition
-    assert (self->checkpoint);
-    //  End function with a RETURN operation
-    self->code [self->code_size++] = VM_RETURN;
-    //  The function is now successfully compiled in the bytecode
-    self->code_head = self->checkpoint;
-    self->checkpoint = 0;
+    //  Walk the body to find the start of its last instruction
+    size_t needle = s_function_body (self, self->checkpoint);
+    size_t last = 0;
+    while (needle < self->code_size) {
+        last = needle;
+        needle += s_instruction_size (s_code (self, needle));
+    }
+    if (last && *s_code (self, last) == VM_CALL) {
+        byte *code = s_code (self, last);
+        size_t body = s_function_body (self, s_decode_address (code + 1));
+        code [0] = VM_JUMP;
+        s_encode_address (code + 1, body);
+    }
 }
 
 
-//  ---------------------------------------------------------------------------
-//  Cancel the current or last function definition and reset the virtual
-//  machine to the state before the previous _define. You can call this
-//  repeatedly to delete function definitions until the machine is empty.
-//  Returns 0 if OK, -1 if there was no function to rollback (the machine
-//  is then empty).
+//  True if the instruction is a constant that we can put in a run
+static bool
+s_is_constant (const byte *code)
+{
+    return *code == VM_WHOLE || *code == VM_REAL || *code == VM_STRING;
+}
 
-int
-zs_vm_rollback (zs_vm_t *self)
+//  Peephole pass over the function we're compiling, which rewrites short
+//  sequences of instructions into cheaper ones:
+//  - UNLOOP goes before a nullary atomic, which doesn't read its input
+//  - a run of constants becomes one VM_CONSTANTS instruction
+//  We don't rewrite across jump targets. The body changes size, so we move
+//  its jump addresses to match.
+
+static void
+s_compile_peephole (zs_vm_t *self)
 {
-    int rc = 0;
-    if (self->checkpoint) {
-        self->code_size = self->checkpoint;
-        self->checkpoint = 0;
-    }
-    else
-    if (self->code_head > 0) {
-        size_t address = self->code_head;
-        assert (self->code [address] == VM_GUARD);
-        size_t offset = (self->code [address + 1] << 8) + self->code [address + 2];
-        assert (address >= offset);
-        self->code_head = address - offset;
-        self->code_size = address;
-    }
-    else
-        rc = -1;
+    size_t body = s_function_body (self, self->checkpoint);
+    size_t size = self->code_size - body;
+    const byte *code = s_code (self, body);
+
+    //  Find jump targets; every jump still lands inside this body
+    bool *target = (bool *) zmalloc (size + 1);
+    size_t offset;
+    for (offset = 0; offset < size; offset += s_instruction_size (code + offset))
+        if (s_is_jump (code [offset])) {
+            size_t address = s_decode_address ((byte *) code + offset + 1);
+            assert (address >= body && address <= body + size);
+            target [address - body] = true;
+        }
 
-    return rc;
+    //  Rewrite the body, noting where each instruction moves to. A run of
+    //  two constants grows by at most half, so this is enough room.
+    byte *rewrite = (byte *) malloc (size * 2 + 2);
+    size_t *moved = (size_t *) malloc ((size + 1) * sizeof (size_t));
+    assert (rewrite && moved);
+    size_t used = 0;
+    offset = 0;
+    while (offset < size) {
+        const byte *instruction = code + offset;
+        size_t length = s_instruction_size (instruction);
+        moved [offset] = used;
+        if (instruction [0] == VM_PIPE && instruction [1] == VM_PIPE_UNLOOP
+        &&  offset + length < size && instruction [length] < VM_CONSTANTS
+        &&  self->atomics [instruction [length]]->type == zs_type_nullary) {
+            offset += length;           //  Drop UNLOOP before nullary atomic
+            continue;
+        }
+        if (s_is_constant (instruction)) {
+            size_t count = 1;
+            size_t next = offset + length;
+            while (next < size && count < 255
+            &&     s_is_constant (code + next) && !target [next]) {
+                next += s_instruction_size (code + next);
+                count++;
+            }
+            if (count > 1) {
+                rewrite [used++] = VM_CONSTANTS;
+                rewrite [used++] = (byte) count;
+                length = next - offset;
+            }
+        }
+        memcpy (rewrite + used, instruction, length);
+        used += length;
+        offset += length;
+    }
+    moved [size] = used;
+    for (offset = 0; offset < used; offset += s_instruction_size (rewrite + offset))
+        if (s_is_jump (rewrite [offset])) {
+            size_t address = s_decode_address (rewrite + offset + 1);
+            s_encode_address (rewrite + offset + 1, body + moved [address - body]);
+        }
+    self->code_size = body;
+    s_emit_data (self, rewrite, used);
+    free (rewrite);
+    free (moved);
+    free (target);
 }
 
 
-//  ---------------------------------------------------------------------------
-//  Compile an inline function call; the actual pipe semantics depend on the
-//  type of the function. Returns 0 if successful, -1 if the function is not
-//  defined.
+//  Jumps that land on an unconditional jump go straight to where it goes.
+//  Only tail calls compile to VM_JUMP, so this saves a hop when a menu or
+//  loop ends just before one, or when a tail call goes to another. Loops
+//  must end in their own function, so their jumps stop at a tail call.
 
-int
-zs_vm_compile_inline (zs_vm_t *self, const char *name)
+static void
+s_compile_thread_jumps (zs_vm_t *self)
 {
-    //  User-defined functions do not touch the pipes; they're effectively
-    //  macros that inline their contents where they are invoked
-    size_t address = s_resolve (self, name);
-    if (!address)
+    size_t body = s_function_body (self, self->checkpoint);
+    size_t needle = body;
+    while (needle < self->code_size) {
+        byte *code = s_code (self, needle);
+        if (s_is_jump (*code)) {
+            bool loop = *code == VM_LOOP || *code == VM_XLOOP || *code == VM_PLOOP;
+            size_t address = s_decode_address (code + 1);
+            while (*s_code (self, address) == VM_JUMP) {
+                size_t target = s_decode_address (s_code (self, address + 1));
+                if (loop && target < body)
+                    break;
+                address = target;
+            }
+            s_encode_address (code + 1, address);
+        }
+        needle += s_instruction_size (code);
+    }
+}
+
+
+//  What the types pass knows about a pipe, at some point in the code. We
+//  know nothing to start with, and at jump targets, where paths meet.
+typedef struct {
+    size_t run;                     //  Wholes on top of the pipe, in a row
+    bool bounded;                   //  Current phrase is just that run
+    bool fresh;                     //  We saw the pipe start out empty
+    bool clean;                     //  Fresh, and only holds wholes
+    bool marked;                    //  Fresh, and holds a phrase mark
+} s_typed_pipe_t;
+
+//  What we know about stdin
+#define STDIN_UNKNOWN   0           //  May hold anything
+#define STDIN_EMPTY     1           //  Holds nothing
+#define STDIN_WHOLE     2           //  Holds only wholes
+
+//  Pipe whose contents we know nothing about
+static void
+s_typed_unknown (s_typed_pipe_t *pipe)
+{
+    memset (pipe, 0, sizeof (s_typed_pipe_t));
+}
+
+//  Pipe we know to be empty, as after a nest
+static void
+s_typed_empty (s_typed_pipe_t *pipe)
+{
+    s_typed_unknown (pipe);
+    pipe->bounded = true;
+    pipe->fresh = true;
+    pipe->clean = true;
+}
+
+//  Send a constant to the pipe
+static void
+s_typed_constant (s_typed_pipe_t *pipe, byte opcode)
+{
+    if (opcode == VM_WHOLE)
+        pipe->run++;
+    else {
+        pipe->run = 0;
+        pipe->bounded = false;
+        pipe->clean = false;
+    }
+}
+
+//  Send an atomic's output to the pipe, as its signature says
+static void
+s_typed_atomic (s_typed_pipe_t *pipe, s_atomic_t *atomic)
+{
+    if (strspn (atomic->output, "w") < strlen (atomic->output))
+        s_typed_unknown (pipe);     //  May send other types
+    else
+    if (atomic->arity >= 0)
+        pipe->run += atomic->arity;
+    else {
+        pipe->run = 0;
+        pipe->bounded = false;
+        if (atomic->arity == ZS_ARITY_ANY)
+            pipe->marked = true;    //  May send marks
+    }
+}
+
+//  Pull the current phrase off the pipe, back to and including its mark, as
+//  greedy and array pulls do when the pipe ends inside a phrase
+static void
+s_typed_pull_phrase (s_typed_pipe_t *pipe)
+{
+    if (pipe->fresh && !pipe->marked)
+        s_typed_empty (pipe);       //  That was everything
+    else {
+        pipe->run = 0;
+        pipe->bounded = false;
+    }
+}
+
+//  Pull values from stdout as the pipe operation does, and return true if
+//  we know they're all whole
+static bool
+s_typed_pull (s_typed_pipe_t *pipe, byte pipe_op)
+{
+    bool whole = false;
+    if (pipe_op == VM_PIPE_SINGLE || pipe_op == VM_PIPE_MODEST) {
+        if (pipe->run) {
+            pipe->run--;            //  Takes the last value
+            whole = true;
+        }
+        else
+        if (pipe->bounded && (pipe_op == VM_PIPE_SINGLE
+                          || (pipe->fresh && !pipe->marked)))
+            whole = true;           //  Takes nothing, and sends a 1
+        else
+            s_typed_unknown (pipe);
+    }
+    else
+    if (pipe_op == VM_PIPE_GREEDY || pipe_op == VM_PIPE_ARRAY) {
+        if (pipe->run && pipe->bounded) {
+            s_typed_pull_phrase (pipe);
+            whole = true;
+        }
+        else
+        if (pipe->bounded && pipe_op == VM_PIPE_ARRAY)
+            whole = true;           //  Takes nothing
+        else
+        if (pipe->bounded) {
+            //  After a phrase, greedy takes the whole sentence
+            whole = pipe->fresh && pipe->clean;
+            if (pipe->fresh)
+                s_typed_empty (pipe);
+            else
+                s_typed_unknown (pipe);
+        }
+        else
+            s_typed_unknown (pipe);
+    }
+    return whole;
+}
+
+//  Types pass over the function we're compiling. We follow the types of
+//  values as they pass through stdout, nests, and stdin, and where an
+//  atomic has a variant for wholes, and gets only wholes, we call that
+//  instead. We know types from constants, and from atomic signatures; an
+//  atomic other than a variant may leave values on stdin, making that
+//  unknown. Where paths meet, we forget everything.
+
+static void
+s_compile_types (zs_vm_t *self)
+{
+    size_t body = s_function_body (self, self->checkpoint);
+    size_t size = self->code_size - body;
+    byte *code = s_code (self, body);
+
+    //  Find jump targets; every jump still lands inside this body
+    bool *target = (bool *) zmalloc (size + 1);
+    size_t offset;
+    for (offset = 0; offset < size; offset += s_instruction_size (code + offset))
+        if (s_is_jump (code [offset]))
+            target [s_decode_address (code + offset + 1) - body] = true;
+
+    //  The pipes we know about: stdout, and outer stdouts during nests
+    s_typed_pipe_t *nests = NULL;
+    size_t nests_max = 0;
+    size_t depth = 0;
+    s_typed_pipe_t stdout_pipe;
+    s_typed_unknown (&stdout_pipe);
+    int stdin_pipe = STDIN_UNKNOWN;
+    bool loop_fn = false;
+
+    for (offset = 0; offset < size; offset += s_instruction_size (code + offset)) {
+        byte *instruction = code + offset;
+        byte opcode = *instruction;
+        if (target [offset]) {
+            size_t index;
+            for (index = 0; index < depth; index++)
+                s_typed_unknown (&nests [index]);
+            s_typed_unknown (&stdout_pipe);
+            stdin_pipe = STDIN_UNKNOWN;
+            loop_fn = false;
+        }
+        if (opcode < VM_CONSTANTS) {
+            s_atomic_t *atomic = self->atomics [opcode];
+            if (loop_fn) {
+                //  Loop functions read loopin, and mark their output
+                s_typed_unknown (&stdout_pipe);
+                loop_fn = false;
+            }
+            else {
+                //  Variants, as from inlined code, stay as they are
+                if (atomic->whole && stdin_pipe != STDIN_UNKNOWN) {
+                    *instruction = atomic->whole;
+                    atomic = self->atomics [atomic->whole];
+                }
+                //  A variant eats all its input
+                stdin_pipe = atomic->generic? STDIN_EMPTY: STDIN_UNKNOWN;
+                s_typed_atomic (&stdout_pipe, atomic);
+            }
+        }
+        else
+        if (opcode == VM_WHOLE || opcode == VM_REAL || opcode == VM_STRING)
+            s_typed_constant (&stdout_pipe, opcode);
+        else
+        if (opcode == VM_CONSTANTS) {
+            byte *constant = instruction + 2;
+            size_t count;
+            for (count = instruction [1]; count; count--) {
+                s_typed_constant (&stdout_pipe, *constant);
+                constant += s_instruction_size (constant);
+            }
+        }
+        else
+        if (opcode == VM_PIPE) {
+            byte pipe_op = instruction [1];
+            if (pipe_op == VM_PIPE_NEST) {
+                nests = (s_typed_pipe_t *) s_stack_reserve (nests, &nests_max,
+                    depth, sizeof (s_typed_pipe_t));
+                nests [depth++] = stdout_pipe;
+                s_typed_empty (&stdout_pipe);
+            }
+            else
+            if (pipe_op == VM_PIPE_UNNEST) {
+                //  The nested output becomes stdin
+                stdin_pipe = stdout_pipe.clean? STDIN_WHOLE: STDIN_UNKNOWN;
+                assert (depth);
+                stdout_pipe = nests [--depth];
+            }
+            else
+            if (pipe_op == VM_PIPE_MARK) {
+                stdout_pipe.run = 0;
+                stdout_pipe.bounded = true;
+                stdout_pipe.marked = true;
+            }
+            else
+            if (pipe_op == VM_PIPE_UNLOOP)
+                loop_fn = true;
+            else {
+                bool whole = s_typed_pull (&stdout_pipe, pipe_op);
+                if (!whole)
+                    stdin_pipe = STDIN_UNKNOWN;
+                else
+                if (stdin_pipe == STDIN_EMPTY)
+                    stdin_pipe = STDIN_WHOLE;
+            }
+        }
+        else
+        if (opcode == VM_JUMPEX)
+            ;                       //  Takes a value off stdin, if any
+        else
+        if (opcode == VM_JUMP || opcode == VM_RETURN || opcode == VM_STOP
+        ||  opcode == VM_XPLOOP || opcode == VM_PLOOP || opcode == VM_CALL) {
+            //  We can't see where these go, or what they do
+            size_t index;
+            for (index = 0; index < depth; index++)
+                s_typed_unknown (&nests [index]);
+            s_typed_unknown (&stdout_pipe);
+            stdin_pipe = STDIN_UNKNOWN;
+        }
+        else
+            //  Loops and sentences take values off stdout
+            s_typed_unknown (&stdout_pipe);
+    }
+    free (nests);
+    free (target);
+}
+
+
+//  Read the stack needs of a committed function; function zero, which is
+//  just VM_STOP, needs nothing
+static void
+s_function_needs (zs_vm_t *self, size_t address, s_needs_t *needs)
+{
+    if (address) {
+        byte *code = s_code (self, s_function_needs_at (self, address));
+        needs->calls = s_decode_address (code);
+        needs->nests = s_decode_address (code + 3);
+        needs->loops = s_decode_address (code + 6);
+    }
+    else
+        memset (needs, 0, sizeof (s_needs_t));
+}
+
+//  Find the committed function that starts at this address, or whose body
+//  does. Returns the function address, or 0 if there is no such function.
+static size_t
+s_verify_function (zs_vm_t *self, size_t address, bool body)
+{
+    size_t function = self->code_head;
+    while (function) {
+        if ((body? s_function_body (self, function): function) == address)
+            return function;
+        size_t offset = (*s_code (self, function + 1) << 8) + *s_code (self, function + 2);
+        function -= offset;
+    }
+    return 0;
+}
+
+//  Return size of the instruction, or 0 if it isn't valid, or runs past
+//  the end of the code
+static size_t
+s_verify_size (zs_vm_t *self, const byte *code, size_t left)
+{
+    byte opcode = *code;
+    size_t size;
+    if (opcode < VM_CONSTANTS)
+        return opcode < self->nbr_atomics? 1: 0;
+    else
+    if (opcode == VM_GUARD || opcode > VM_CALL)
+        return 0;
+    else
+    if (opcode == VM_STRING) {
+        const byte *end = (const byte *) memchr (code + 1, 0, left - 1);
+        return end? end - code + 1: 0;
+    }
+    else
+    if (opcode == VM_PIPE)
+        size = left > 1 && code [1] >= VM_PIPE_NEST && code [1] <= VM_PIPE_MARK? 2: 0;
+    else
+    if (opcode == VM_CONSTANTS) {
+        if (left < 2 || code [1] == 0)
+            return 0;
+        size = 2;
+        size_t count;
+        for (count = code [1]; count; count--) {
+            if (size >= left || !s_is_constant (code + size))
+                return 0;
+            size_t constant = s_verify_size (self, code + size, left - size);
+            if (!constant)
+                return 0;
+            size += constant;
+        }
+    }
+    else
+        size = s_instruction_size (code);
+    return size <= left? size: 0;
+}
+
+//  Verifier state: the nest and loop depths we saw at each instruction, and
+//  the instructions we still have to follow
+typedef struct {
+    bool *start;                    //  True where an instruction starts
+    size_t *nests;                  //  Nest depth at instruction, or SIZE_MAX
+    size_t *loops;                  //  Loop depth at instruction, or SIZE_MAX
+    size_t *todo;                   //  Instructions to follow
+    size_t nbr_todo;                //  How many there are
+} s_verify_t;
+
+//  Flow into the instruction at this offset with these depths. Returns
+//  NULL if OK, else the reason why not.
+static const char *
+s_verify_flow (s_verify_t *verify, size_t offset, size_t nests, size_t loops)
+{
+    if (!verify->start [offset])
+        return "jump into the middle of an instruction";
+    if (verify->nests [offset] == SIZE_MAX) {
+        verify->nests [offset] = nests;
+        verify->loops [offset] = loops;
+        verify->todo [verify->nbr_todo++] = offset;
+    }
+    else
+    if (verify->nests [offset] != nests || verify->loops [offset] != loops)
+        return "stack depths differ where paths meet";
+    return NULL;
+}
+
+//  Add the needs of a function we call or jump to, at the current depths
+static void
+s_verify_callee (zs_vm_t *self, s_needs_t *needs, size_t function,
+                 size_t calls, size_t nests, size_t loops)
+{
+    s_needs_t callee;
+    s_function_needs (self, function, &callee);
+    if (needs->calls < calls + callee.calls)
+        needs->calls = calls + callee.calls;
+    if (needs->nests < nests + callee.nests)
+        needs->nests = nests + callee.nests;
+    if (needs->loops < loops + callee.loops)
+        needs->loops = loops + callee.loops;
+}
+
+//  Verify the function we're committing, before anything can run it. Every
+//  instruction must decode, every jump must land on an instruction, every
+//  call on a committed function, and the nest and loop stacks must balance
+//  on every path. Loops may only jump forwards on entry, so that code with
+//  no safepoint can't go backwards. We also work out how deep the stacks can get, counting
+//  the functions we call; that has a limit, since a function can only call
+//  functions defined before it. Returns NULL if the code is valid, else
+//  the reason why it isn't.
+
+static const char *
+s_verify (zs_vm_t *self, s_needs_t *needs)
+{
+    memset (needs, 0, sizeof (s_needs_t));
+    size_t body = s_function_body (self, self->checkpoint);
+    size_t size = self->code_size - body;
+    const byte *code = s_code (self, body);
+
+    s_verify_t verify;
+    verify.start = (bool *) zmalloc (size + 1);
+    verify.nests = (size_t *) malloc ((size + 1) * sizeof (size_t));
+    verify.loops = (size_t *) malloc ((size + 1) * sizeof (size_t));
+    verify.todo = (size_t *) malloc ((size + 1) * sizeof (size_t));
+    verify.nbr_todo = 0;
+    assert (verify.start && verify.nests && verify.loops && verify.todo);
+    memset (verify.nests, 0xFF, (size + 1) * sizeof (size_t));
+    memset (verify.loops, 0xFF, (size + 1) * sizeof (size_t));
+
+    //  Decode each instruction in turn
+    const char *error = NULL;
+    size_t offset = 0;
+    while (offset < size && !error) {
+        verify.start [offset] = true;
+        size_t length = s_verify_size (self, code + offset, size - offset);
+        if (length)
+            offset += length;
+        else
+            error = "invalid instruction";
+    }
+    if (!error && (size == 0 || code [size - 1] != VM_RETURN || !verify.start [size - 1]))
+        error = "function does not end with RETURN";
+    if (!error)
+        error = s_verify_flow (&verify, 0, 0, 0);
+
+    //  Follow every path through the code
+    while (verify.nbr_todo && !error) {
+        offset = verify.todo [--verify.nbr_todo];
+        size_t nests = verify.nests [offset];
+        size_t loops = verify.loops [offset];
+        if (needs->nests < nests)
+            needs->nests = nests;
+        if (needs->loops < loops)
+            needs->loops = loops;
+
+        const byte *instruction = code + offset;
+        byte opcode = *instruction;
+        size_t next = offset + s_instruction_size (instruction);
+        size_t target = 0;
+        bool inside = false;
+        if (opcode == VM_CALL)
+            target = s_decode_address ((byte *) instruction + 1);
+        else
+        if (s_is_jump (opcode)) {
+            //  Only tail calls may jump out, to the body of another function
+            target = s_decode_address ((byte *) instruction + 1);
+            inside = target >= body && target < body + size;
+            if (inside) {
+                target -= body;
+                //  Only jumps with a safepoint may go backwards
+                if (target <= offset
+                &&  (opcode == VM_LOOP || opcode == VM_PLOOP)) {
+                    error = "loop jumps backwards";
+                    continue;
+                }
+            }
+            else
+            if (opcode == VM_LOOP || opcode == VM_XLOOP || opcode == VM_PLOOP
+            ||  !s_verify_function (self, target, true)) {
+                error = "jump out of the function";
+                continue;
+            }
+        }
+        if (opcode == VM_CALL) {
+            size_t function = s_verify_function (self, target, false);
+            if (function)
+                s_verify_callee (self, needs, function, 1, nests, loops);
+            else
+                error = "call to unknown function";
+        }
+        else
+        if (opcode == VM_RETURN || opcode == VM_XPLOOP) {
+            if (nests || loops)
+                error = "stacks don't balance";
+            continue;
+        }
+        else
+        if (opcode == VM_STOP)
+            continue;
+        else
+        if (opcode == VM_LOOP) {
+            //  The loop pushes its input on entry, and pops it if it skips
+            error = s_verify_flow (&verify, target, nests, loops);
+            loops++;
+        }
+        else
+        if (opcode == VM_XLOOP) {
+            if (loops == 0) {
+                error = "loop ends outside a loop";
+                continue;
+            }
+            error = s_verify_flow (&verify, target, nests, loops);
+            loops--;
+        }
+        else
+        if (opcode == VM_PLOOP) {
+            //  The body runs in workers, from empty stacks
+            error = s_verify_flow (&verify, target, nests, loops);
+            if (!error)
+                error = s_verify_flow (&verify, next, 0, 0);
+            continue;
+        }
+        else
+        if (opcode == VM_JUMP || opcode == VM_JUMPEX) {
+            if (inside)
+                error = s_verify_flow (&verify, target, nests, loops);
+            else
+            if (nests || loops)
+                error = "stacks don't balance";
+            else
+                //  A tail call, which runs in our own frame
+                s_verify_callee (self, needs,
+                    s_verify_function (self, target, true), 0, nests, loops);
+            if (opcode == VM_JUMP)
+                continue;
+        }
+        else
+        if (opcode == VM_PIPE && instruction [1] == VM_PIPE_NEST)
+            nests++;
+        else
+        if (opcode == VM_PIPE && instruction [1] == VM_PIPE_UNNEST) {
+            if (nests == 0) {
+                error = "nested call ends outside a nest";
+                continue;
+            }
+            nests--;
+        }
+        if (!error)
+            error = s_verify_flow (&verify, next, nests, loops);
+    }
+    free (verify.start);
+    free (verify.nests);
+    free (verify.loops);
+    free (verify.todo);
+    return error;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Close the current function definition, and verify its code. Returns 0
+//  if OK, -1 if the code is invalid; the definition then stays open, and
+//  the caller should roll it back.
+
+int
+zs_vm_commit (zs_vm_t *self)
+{
+    //  We must have an open function definition
+    assert (self->checkpoint);
+    if (self->peephole)
+        s_compile_peephole (self);
+    if (self->specialize)
+        s_compile_types (self);
+    if (self->tail_calls)
+        s_compile_tail_call (self);
+    //  End function with a RETURN operation; jumps that leave the function
+    //  land on this, so it must be there before we thread them
+    s_emit (self, VM_RETURN);
+    if (self->peephole)
+        s_compile_thread_jumps (self);
+
+    //  Nothing runs code that hasn't been verified, so the interpreter can
+    //  trust it. Failure means a bug in the compiler, which the caller
+    //  reports as an error.
+    s_needs_t needs;
+    if (s_verify (self, &needs))
+        return -1;
+    byte *header = s_code (self, s_function_needs_at (self, self->checkpoint));
+    s_encode_address (header, needs.calls);
+    s_encode_address (header + 3, needs.nests);
+    s_encode_address (header + 6, needs.loops);
+
+    //  The function is now successfully compiled in the bytecode
+    self->code_head = self->checkpoint;
+    self->checkpoint = 0;
+    return 0;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Cancel the current or last function definition and reset the virtual
+//  machine to the state before the previous _define. You can call this
+//  repeatedly to delete function definitions until the machine is empty.
+//  Returns 0 if OK, -1 if there was no function to rollback (the machine
+//  is then empty).
+
+int
+zs_vm_rollback (zs_vm_t *self)
+{
+    int rc = 0;
+    if (self->checkpoint) {
+        self->code_size = self->checkpoint;
+        self->checkpoint = 0;
+    }
+    else
+    if (self->code_head > 0 && self->code_head >= self->code_base) {
+        //  A forked VM can only roll back its own functions
+        assert (!__atomic_load_n (&self->nbr_forks, __ATOMIC_SEQ_CST));
+        size_t address = self->code_head;
+        assert (*s_code (self, address) == VM_GUARD);
+        size_t offset = (*s_code (self, address + 1) << 8) + *s_code (self, address + 2);
+        assert (address >= offset);
+        self->code_head = address - offset;
+        self->code_size = address;
+    }
+    else
+        rc = -1;
+
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Compile an inline function call; the actual pipe semantics depend on the
+//  type of the function. Returns 0 if successful, -1 if the function is not
+//  defined.
+
+int
+zs_vm_compile_inline (zs_vm_t *self, const char *name)
+{
+    //  User-defined functions do not touch the pipes; they're effectively
+    //  macros that inline their contents where they are invoked
+    size_t address = s_resolve (self, name);
+    if (!address)
         return -1;              //  Undefined function, forget it
 
     byte pipe_op = 0;
@@ -510,10 +1830,9 @@ zs_vm_compile_nest (zs_vm_t *self, const char *name)
     if (!address)
         return -1;              //  Undefined function, forget it
 
-    self->code [self->code_size++] = VM_PIPE;
-    self->code [self->code_size++] = VM_PIPE_NEST;
-    assert (self->scope_stack_ptr < MAX_SCOPE);
-    self->scope_stack [self->scope_stack_ptr++] = address;
+    s_emit (self, VM_PIPE);
+    s_emit (self, VM_PIPE_NEST);
+    s_scope_push (self, address);
     return 0;
 }
 
@@ -553,20 +1872,20 @@ zs_vm_compile_loop (zs_vm_t *self, const char *name)
     //
     //   - push loop_address for xloop so it can fill in the blanks
     //   - use a magic value A5A5A5 to double-check this code
-    assert (self->scope_stack_ptr < MAX_SCOPE);
-    self->scope_stack [self->scope_stack_ptr++] = self->code_size + 1;
-    self->code [self->code_size++] = VM_LOOP;
-    self->code [self->code_size++] = 0xA5;
-    self->code [self->code_size++] = 0xA5;
-    self->code [self->code_size++] = 0xA5;
+    //
+    //  Parallel loops are tagged with VM_PLOOP instead, and their body runs
+    //  on worker VMs; the loop address then points past the body.
+    s_scope_push (self, self->code_size + 1);
+    s_emit (self, s_is_parallel (self, fn_address)? VM_PLOOP: VM_LOOP);
+    s_emit (self, 0xA5);
+    s_emit (self, 0xA5);
+    s_emit (self, 0xA5);
 
     //  Push function address to scope stack for xloop
-    assert (self->scope_stack_ptr < MAX_SCOPE);
-    self->scope_stack [self->scope_stack_ptr++] = fn_address;
+    s_scope_push (self, fn_address);
 
     //  Push body address to scope stack for xloop
-    assert (self->scope_stack_ptr < MAX_SCOPE);
-    self->scope_stack [self->scope_stack_ptr++] = self->code_size;
+    s_scope_push (self, self->code_size);
 
     return 0;
 }
@@ -596,22 +1915,27 @@ zs_vm_compile_xloop (zs_vm_t *self)
     assert (self->scope_stack_ptr);
     size_t loop_address = self->scope_stack [--self->scope_stack_ptr];
 
-    //  VM: execute loop function with unloop pipe semantics
-    s_compile_call (self, fn_address, VM_PIPE_UNLOOP);
-
-    //  VM: evaluate loop event and jump to body if positive
-    self->code [self->code_size++] = VM_XLOOP;
-    self->code [self->code_size++] = (byte) (body_address >> 16);
-    self->code [self->code_size++] = (byte) (body_address >> 8);
-    self->code [self->code_size++] = (byte) (body_address);
+    if (s_is_parallel (self, fn_address))
+        //  VM: end the parallel loop body, in the worker VM
+        s_emit (self, VM_XPLOOP);
+    else {
+        //  VM: execute loop function with unloop pipe semantics
+        s_compile_call (self, fn_address, VM_PIPE_UNLOOP);
+
+        //  VM: evaluate loop event and jump to body if positive
+        s_emit (self, VM_XLOOP);
+        s_emit (self, (byte) (body_address >> 16));
+        s_emit (self, (byte) (body_address >> 8));
+        s_emit (self, (byte) (body_address));
+    }
 
     //  Fix VM_LOOP argument to point to current code_size
-    assert (self->code [loop_address + 0] == 0xA5);
-    assert (self->code [loop_address + 1] == 0xA5);
-    assert (self->code [loop_address + 2] == 0xA5);
-    self->code [loop_address++] = (byte) (self->code_size >> 16);
-    self->code [loop_address++] = (byte) (self->code_size >> 8);
-    self->code [loop_address++] = (byte) (self->code_size);
+    assert (*s_code (self, loop_address + 0) == 0xA5);
+    assert (*s_code (self, loop_address + 1) == 0xA5);
+    assert (*s_code (self, loop_address + 2) == 0xA5);
+    *s_code (self, loop_address++) = (byte) (self->code_size >> 16);
+    *s_code (self, loop_address++) = (byte) (self->code_size >> 8);
+    *s_code (self, loop_address++) = (byte) (self->code_size);
 }
 
 
@@ -622,17 +1946,16 @@ void
 zs_vm_compile_menu (zs_vm_t *self)
 {
     //  VM: pull test value from loop function
-    self->code [self->code_size++] = VM_PIPE;
-    self->code [self->code_size++] = VM_PIPE_SINGLE;
+    s_emit (self, VM_PIPE);
+    s_emit (self, VM_PIPE_SINGLE);
 
     //  Stack address of jump address
     //  Leave 24 bits for the jump address, fill with magic
-    assert (self->scope_stack_ptr < MAX_SCOPE);
-    self->scope_stack [self->scope_stack_ptr++] = self->code_size + 1;
-    self->code [self->code_size++] = VM_JUMPEX;
-    self->code [self->code_size++] = 0xA5;
-    self->code [self->code_size++] = 0xA5;
-    self->code [self->code_size++] = 0xA5;
+    s_scope_push (self, self->code_size + 1);
+    s_emit (self, VM_JUMPEX);
+    s_emit (self, 0xA5);
+    s_emit (self, 0xA5);
+    s_emit (self, 0xA5);
 }
 
 
@@ -644,14 +1967,14 @@ zs_vm_compile_xmenu (zs_vm_t *self)
 {
     //  Pop location of jump address
     size_t address = self->scope_stack [--self->scope_stack_ptr];
-    assert (self->code [address + 0] == 0xA5);
-    assert (self->code [address + 1] == 0xA5);
-    assert (self->code [address + 2] == 0xA5);
+    assert (*s_code (self, address + 0) == 0xA5);
+    assert (*s_code (self, address + 1) == 0xA5);
+    assert (*s_code (self, address + 2) == 0xA5);
 
     //  Store current code_size into jump address
-    self->code [address++] = (byte) (self->code_size >> 16);
-    self->code [address++] = (byte) (self->code_size >> 8);
-    self->code [address++] = (byte) (self->code_size);
+    *s_code (self, address++) = (byte) (self->code_size >> 16);
+    *s_code (self, address++) = (byte) (self->code_size >> 8);
+    *s_code (self, address++) = (byte) (self->code_size);
 }
 
 
@@ -662,8 +1985,8 @@ zs_vm_compile_xmenu (zs_vm_t *self)
 void
 zs_vm_compile_phrase (zs_vm_t *self)
 {
-    self->code [self->code_size++] = VM_PIPE;
-    self->code [self->code_size++] = VM_PIPE_MARK;
+    s_emit (self, VM_PIPE);
+    s_emit (self, VM_PIPE_MARK);
 }
 
 
@@ -674,7 +1997,7 @@ zs_vm_compile_phrase (zs_vm_t *self)
 void
 zs_vm_compile_sentence (zs_vm_t *self)
 {
-    self->code [self->code_size++] = VM_SENTENCE;
+    s_emit (self, VM_SENTENCE);
 }
 
 
@@ -686,8 +2009,23 @@ zs_vm_dump (zs_vm_t *self)
 {
     printf ("Primitives: %zd\n", self->nbr_atomics);
     size_t index;
-    for (index = 0; index < self->nbr_atomics; index++)
-        printf (" - %s: %s\n", self->atomics [index]->name, self->atomics [index]->hint);
+    for (index = 0; index < self->nbr_atomics; index++) {
+        //  Signature is types taken -> types sent, arity, effect
+        s_atomic_t *atomic = self->atomics [index];
+        char arity [24];
+        if (atomic->arity == ZS_ARITY_EACH)
+            strcpy (arity, "each");
+        else
+        if (atomic->arity == ZS_ARITY_ANY)
+            strcpy (arity, "any");
+        else
+            snprintf (arity, sizeof (arity), "%d", atomic->arity);
+        printf (" - %s: %s (%s -> %s, %s, %s)\n", atomic->name, atomic->hint,
+                *atomic->input? atomic->input: "none",
+                *atomic->output? atomic->output: "none", arity,
+                atomic->effect == zs_effect_pure? "pure":
+                atomic->effect == zs_effect_reads? "reads": "writes");
+    }
     printf ("Compiled size: %zd\n", self->code_size);
 }
 
@@ -715,10 +2053,10 @@ zs_vm_function_next (zs_vm_t *self)
 {
     if (self->userspace) {
         if (self->iterator) {
-            assert (self->code [self->iterator] == VM_GUARD);
+            assert (*s_code (self, self->iterator) == VM_GUARD);
             const char *name = s_function_name (self, self->iterator);
-            size_t offset = (self->code [self->iterator + 1] << 8)
-                           + self->code [self->iterator + 2];
+            size_t offset = (*s_code (self, self->iterator + 1) << 8)
+                           + *s_code (self, self->iterator + 2);
             assert (self->iterator >= offset);
             self->iterator -= offset;
             return name;
@@ -727,10 +2065,11 @@ zs_vm_function_next (zs_vm_t *self)
             self->userspace = false;
     }
     if (self->iterator < self->nbr_atomics) {
-        const char *name = self->atomics [self->iterator]->name;
+        s_atomic_t *atomic = self->atomics [self->iterator];
+        const char *name = atomic->name;
         self->iterator++;
-        //  Don't report system functions starting with $
-        if (name [0] == '$')
+        //  Don't report system functions starting with $, or variants
+        if (name [0] == '$' || atomic->generic)
             return zs_vm_function_next (self);
         else
             return name;
@@ -755,95 +2094,464 @@ zs_vm_set_verbose (zs_vm_t *self, bool verbose)
 void
 zs_vm_trace_pipes (zs_vm_t *self, bool trace)
 {
-    self->verbose = trace;
-    self->debug = trace;
+    zs_exec_t *exec = s_exec (self);
+    exec->verbose = trace;
+    exec->debug = trace;
+    s_exec_set_tracing (exec);
 }
 
 
-//  ---------------------------------------------------------------------------
-//  Atomic API: provides current loop state pipe; for use by loop atomics.
+static const char *s_trace_name (void *args, const zs_trace_event_t *event);
 
-zs_pipe_t *
-zs_vm_loop_state (zs_vm_t *self)
+//  If the process aborts while this thread runs a context with a trace
+//  ring, print the ring, then pass the signal on to the previous handler
+static void (*s_abort_next) (int) = SIG_DFL;
+
+static void
+s_abort_handler (int signum)
 {
-    return NULL;
+    signal (SIGABRT, s_abort_next);
+    zs_exec_t *exec = s_running;
+    if (exec && exec->trace) {
+        fprintf (stderr, "E: aborted, last instructions executed:\n");
+        zs_trace_print (exec->trace, stderr, s_trace_name, exec->vm);
+        fflush (stderr);
+    }
+    raise (signum);
 }
 
 
 //  ---------------------------------------------------------------------------
-//  Run last defined function, if any, in the VM. This continues forever or
-//  until the function ends. Returns 0 if stopped successfully, or -1 if
-//  stopped due to some error. Each run of the VM starts with clean pipes.
+//  Atomic API: keep a trace of the last limit instructions executed, in a
+//  ring of binary events; a limit of zero switches tracing off. Starts a
+//  new trace each time. If the process aborts while the trace is on, it
+//  prints the trace to stderr.
 
-static size_t
-s_decode_address (byte *code)
+void
+zs_vm_set_trace (zs_vm_t *self, size_t limit)
 {
-    return (size_t) (code [0] << 16) + (size_t) (code [1] << 8) + (size_t) (code [2]);
+    zs_exec_t *exec = s_exec (self);
+    zs_trace_destroy (&exec->trace);
+    if (limit) {
+        exec->trace = zs_trace_new (limit);
+        //  Install our abort handler once per process
+        static int installed = 0;
+        if (!__atomic_exchange_n (&installed, 1, __ATOMIC_ACQ_REL)) {
+            s_abort_next = signal (SIGABRT, s_abort_handler);
+            if (s_abort_next == SIG_ERR)
+                s_abort_next = SIG_DFL;
+        }
+    }
+    s_exec_set_tracing (exec);
 }
 
+//  ---------------------------------------------------------------------------
+//  Print the trace ring to the file, oldest instruction first, as text or as
+//  Chrome trace event JSON. Prints nothing if tracing is off.
 
-int
-zs_vm_run (zs_vm_t *self)
+void
+zs_vm_trace_print (zs_vm_t *self, FILE *file, bool json)
 {
-    assert (!self->checkpoint);
-//     static size_t quota = 250;
+    zs_exec_t *exec = s_exec (self);
+    if (exec->trace) {
+        if (json)
+            zs_trace_print_json (exec->trace, file, s_trace_name, self);
+        else
+            zs_trace_print (exec->trace, file, s_trace_name, self);
+    }
+}
 
-    //  We call the last function that was defined, which is at code_head.
-    //  When this function returns, the VM ends at needle = 0, and stops.
-    assert (self->code [0] == VM_STOP);
-    size_t needle = s_function_body (self, self->code_head);
-    self->call_stack [0] = 0;
-    self->call_stack_ptr = 1;
 
-    if (self->verbose)
-        printf ("D [%04zd]: run '%s'\n", needle, s_function_name (self, self->code_head));
+//  ---------------------------------------------------------------------------
+//  Atomic API: switch execution profiling on or off. Switching it on starts
+//  a new profile. The profile counts calls and time spent in each atomic,
+//  and in each user function including the functions it calls. Switching
+//  profiling off keeps the profile, for reporting.
 
-    //  Clean pipes before each run
-    zs_pipe_purge (self->stdin);
-    zs_pipe_purge (self->stdout);
-    zs_pipe_purge (self->loopin);
+void
+zs_vm_set_profile (zs_vm_t *self, bool profile)
+{
+    zs_exec_t *exec = s_exec (self);
+    if (profile) {
+        s_profile_destroy (&exec->profile);
+        exec->profile = s_profile_new ();
+    }
+    exec->profiling = profile;
+}
 
-    //  Run virtual machine until stopped or interrupted
-    while (!zctx_interrupted) {
-//         if (--quota == 0) {
-//             puts ("EXPIRED");
-//             break;
-//         }
-        if (self->debug) {
-            zs_pipe_print (self->stdin, "Stdin:   ");
-            zs_pipe_print (self->stdout, "Stdout:  ");
-            zs_pipe_print (self->loopin, "Loopin:  ");
+//  Sort counters by time, most expensive first
+static int
+s_compare_counters (const void *item1, const void *item2)
+{
+    const s_counter_t *counter1 = *(const s_counter_t **) item1;
+    const s_counter_t *counter2 = *(const s_counter_t **) item2;
+    if (counter1->nanos != counter2->nanos)
+        return counter1->nanos < counter2->nanos? 1: -1;
+    return (counter1->calls < counter2->calls) - (counter1->calls > counter2->calls);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return the most expensive profile entry, by total time; use with next to
+//  iterate through the profile, and zs_vm_profile_calls/nanos to read the
+//  current entry. Returns the atomic or function name, or NULL if nothing
+//  has been profiled.
+
+const char *
+zs_vm_profile_first (zs_vm_t *self)
+{
+    s_profile_t *profile = s_exec (self)->profile;
+    if (!profile)
+        return NULL;
+
+    free (profile->sorted);
+    profile->sorted = (s_counter_t **) zmalloc (
+        (240 + profile->nbr_functions) * sizeof (s_counter_t *));
+    assert (profile->sorted);
+    profile->nbr_sorted = 0;
+    size_t index;
+    for (index = 0; index < 240; index++)
+        if (profile->atomics [index].calls)
+            profile->sorted [profile->nbr_sorted++] = &profile->atomics [index];
+    for (index = 0; index < profile->functions_max; index++)
+        if (profile->functions [index].calls)
+            profile->sorted [profile->nbr_sorted++] = &profile->functions [index];
+    qsort (profile->sorted, profile->nbr_sorted, sizeof (s_counter_t *), s_compare_counters);
+    profile->cursor = 0;
+    return profile->nbr_sorted? profile->sorted [0]->name: NULL;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return the next profile entry, in order of decreasing total time. Returns
+//  the atomic or function name, or NULL if there are no more.
+
+const char *
+zs_vm_profile_next (zs_vm_t *self)
+{
+    s_profile_t *profile = s_exec (self)->profile;
+    if (!profile || profile->cursor + 1 >= profile->nbr_sorted)
+        return NULL;
+    return profile->sorted [++profile->cursor]->name;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return number of calls for the current profile entry.
+
+uint64_t
+zs_vm_profile_calls (zs_vm_t *self)
+{
+    s_profile_t *profile = s_exec (self)->profile;
+    if (!profile || profile->cursor >= profile->nbr_sorted)
+        return 0;
+    return profile->sorted [profile->cursor]->calls;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return total time in nanoseconds for the current profile entry.
+
+uint64_t
+zs_vm_profile_nanos (zs_vm_t *self)
+{
+    s_profile_t *profile = s_exec (self)->profile;
+    if (!profile || profile->cursor >= profile->nbr_sorted)
+        return 0;
+    return profile->sorted [profile->cursor]->nanos;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Atomic API: provides current loop state pipe; for use by loop atomics.
+
+zs_pipe_t *
+zs_vm_loop_state (zs_vm_t *self)
+{
+    return NULL;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Take input from a ring. Each run of the VM first receives one sentence
+//  from the ring, as if its values had been typed before the function. The
+//  VM does not own the ring.
+
+void
+zs_vm_set_input (zs_vm_t *self, zs_ring_t *ring)
+{
+    s_exec (self)->input = ring;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Attach a ring as a named output port, for use by zs_vm_connect. The VM
+//  does not own the ring, but prepares it to carry values; attach it before
+//  any thread sends on it.
+
+void
+zs_vm_attach (zs_vm_t *self, const char *name, zs_ring_t *ring)
+{
+    assert (name);
+    assert (ring);
+    s_port_t *port = (s_port_t *) zmalloc (sizeof (s_port_t));
+    assert (port);
+    port->name = strdup (name);
+    port->ring = ring;
+    zs_pipe_prepare_ring (ring);
+    zlistx_add_end (self->ports, port);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Atomic API: send each sentence's output to the named port, so it becomes
+//  the input of the VM reading that ring. An empty name disconnects. Returns
+//  0 if OK, or -1 if there is no such port. Parallel work has no sentences
+//  to send, and may not walk the shared list of ports, so this fails there.
+
+int
+zs_vm_connect (zs_vm_t *self, const char *name)
+{
+    if (s_exec (self)->worker)
+        return -1;
+    if (*name == 0) {
+        s_exec (self)->output = NULL;
+        return 0;
+    }
+    s_port_t *port = (s_port_t *) zlistx_first (self->ports);
+    while (port) {
+        if (streq (port->name, name)) {
+            s_exec (self)->output = port->ring;
+            return 0;
         }
-        if (self->verbose)
-            printf ("D [%04zd]: ", needle);
-        byte opcode = self->code [needle++];
-        if (opcode < 240) {
-            if (self->verbose)
-                printf ("atomic=%s\n", self->atomics [opcode]->name);
-            if ((self->atomics [opcode]->function) (self,
+        port = (s_port_t *) zlistx_next (self->ports);
+    }
+    return -1;
+}
+
+
+//  Count a call to an atomic, which started at the given time
+static void
+s_profile_atomic (zs_exec_t *self, byte opcode, uint64_t started)
+{
+    s_counter_t *counter = &self->profile->atomics [opcode];
+    if (!counter->name)
+        counter->name = strdup (self->vm->atomics [opcode]->name);
+    counter->calls++;
+    counter->nanos += s_now () - started;
+}
+
+//  Count a return from the function timed in this frame; calls made before
+//  profiling started have no address, and are not counted
+static void
+s_profile_return (zs_exec_t *self, size_t frame)
+{
+    s_profile_t *profile = self->profile;
+    size_t address = frame < profile->frames_max? profile->frame_address [frame]: 0;
+    if (address) {
+        s_counter_t *counter = s_profile_function (profile, address);
+        if (!counter->name)
+            counter->name = strdup (s_function_name (self->vm, address));
+        counter->calls++;
+        counter->nanos += s_now () - profile->frame_started [frame];
+        profile->frame_address [frame] = 0;
+    }
+}
+
+//  Names of built-in opcodes, from VM_CONSTANTS upwards
+static char
+*opcode_name [] = {
+    "CONSTANTS", "STOP", "GUARD", "XPLOOP", "PLOOP", "SENTENCE", "PIPE", "STRING",
+    "REAL", "WHOLE", "JUMPEX", "JUMP", "XLOOP", "LOOP", "RETURN", "CALL", "?"
+};
+
+//  Name a trace event, for the trace dumpers
+static const char *
+s_trace_name (void *args, const zs_trace_event_t *event)
+{
+    zs_vm_t *self = (zs_vm_t *) args;
+    if (event->opcode < VM_CONSTANTS)
+        return event->opcode < self->nbr_atomics? self->atomics [event->opcode]->name: "?";
+    else
+    if (event->opcode == VM_CALL) {
+        //  The function may have been rolled back since
+        if (event->address < self->code_size
+        &&  *s_code (self, event->address) == VM_GUARD)
+            return s_function_name (self, event->address);
+        return "?";
+    }
+    else
+    if (event->opcode == VM_PIPE && event->address < 9)
+        return pipe_op_name [event->address];
+    else
+        return opcode_name [event->opcode - VM_CONSTANTS];
+}
+
+//  Send the constants we're holding to stdout. We do this before anything
+//  else can look at stdout, so the registers are invisible to atomics.
+static void
+s_exec_flush (zs_exec_t *self)
+{
+    size_t index;
+    for (index = 0; index < self->nbr_registers; index++) {
+        s_register_t *reg = &self->registers [index];
+        if (reg->type == 'w')
+            zs_pipe_send_whole (self->stdout, reg->whole);
+        else
+            zs_pipe_send_real (self->stdout, reg->real);
+    }
+    self->nbr_registers = 0;
+}
+
+//  Hold a number constant in the next register, flushing if they're full
+static inline s_register_t *
+s_exec_hold (zs_exec_t *self, char type)
+{
+    if (self->nbr_registers == REGISTERS)
+        s_exec_flush (self);
+    s_register_t *reg = &self->registers [self->nbr_registers++];
+    reg->type = type;
+    return reg;
+}
+
+//  Send one register to stdin, as a pull would
+static inline void
+s_exec_pull_register (zs_exec_t *self, s_register_t *reg)
+{
+    if (reg->type == 'w')
+        zs_pipe_send_whole (self->stdin, reg->whole);
+    else
+        zs_pipe_send_real (self->stdin, reg->real);
+}
+
+//  Trace one instruction before we execute it; this is only called when
+//  some kind of tracing is enabled
+static void
+s_trace_step (zs_exec_t *self, size_t needle, byte opcode)
+{
+    //  Traces show the pipes as though we held nothing back
+    s_exec_flush (self);
+    zs_trace_event_t event = { 0 };
+    event.nanos = s_now ();
+    event.needle = (uint32_t) needle;
+    event.opcode = opcode;
+    event.depth = self->call_stack_ptr > 255? 255: (byte) self->call_stack_ptr;
+    size_t stdin_size = zs_pipe_size (self->stdin);
+    size_t stdout_size = zs_pipe_size (self->stdout);
+    event.stdin_size = stdin_size > 0xFFFF? 0xFFFF: (uint16_t) stdin_size;
+    event.stdout_size = stdout_size > 0xFFFF? 0xFFFF: (uint16_t) stdout_size;
+    if (opcode == VM_CALL) {
+        event.kind = zs_trace_call;
+        event.address = (uint32_t) s_decode_address (s_code (self->vm, needle + 1));
+    }
+    else
+    if (opcode == VM_RETURN)
+        event.kind = zs_trace_return;
+    else
+    if (opcode == VM_PIPE)
+        event.address = *s_code (self->vm, needle + 1);
+
+    if (self->trace)
+        zs_trace_record (self->trace, &event);
+    if (self->debug) {
+        zs_pipe_print (self->stdin, "Stdin:   ");
+        zs_pipe_print (self->stdout, "Stdout:  ");
+        zs_pipe_print (self->loopin, "Loopin:  ");
+    }
+    if (self->verbose || self->vm->verbose)
+        zs_trace_event_print (&event, s_trace_name (self->vm, &event), stdout);
+}
+
+//  Make a stack at least this deep, keeping what it holds
+static void *
+s_stack_fit (void *stack, size_t *max_p, size_t depth, size_t item_size)
+{
+    if (*max_p < depth) {
+        stack = realloc (stack, depth * item_size);
+        assert (stack);
+        *max_p = depth;
+    }
+    return stack;
+}
+
+//  Make the context's stacks deep enough for code with these needs, plus
+//  the frame that returns to address zero. The verifier worked the needs
+//  out, so the interpreter never has to check or grow a stack.
+static void
+s_exec_fit (zs_exec_t *self, size_t calls, size_t nests, size_t loops)
+{
+    self->call_stack = (size_t *) s_stack_fit (self->call_stack,
+        &self->call_stack_max, calls + 1, sizeof (size_t));
+    self->nest_stack = (zs_pipe_t **) s_stack_fit (self->nest_stack,
+        &self->nest_stack_max, nests, sizeof (zs_pipe_t *));
+    self->loop_stack = (zs_pipe_t **) s_stack_fit (self->loop_stack,
+        &self->loop_stack_max, loops, sizeof (zs_pipe_t *));
+}
+
+static int s_parallel_loop (zs_exec_t *self, size_t body, int64_t cycles);
+
+//  Execute code from the needle until it returns to address zero, or stops.
+//  Returns 0 if stopped successfully, or -1 if stopped due to some error.
+
+static int
+s_execute (zs_exec_t *self, size_t needle)
+{
+    zs_vm_t *vm = self->vm;
+    zs_exec_t *caller = s_running;
+    s_running = self;
+
+    //  When the code returns, the VM ends at needle = 0, and stops. Our
+    //  caller has made the stacks as deep as the verifier says we need.
+    assert (*s_code (vm, 0) == VM_STOP);
+    assert (self->call_stack_max > 0);
+    self->call_stack [0] = 0;
+    self->call_stack_ptr = 1;
+    size_t nest_base = self->nest_stack_ptr;
+    size_t loop_base = self->loop_stack_ptr;
+
+    //  Run virtual machine until stopped or interrupted. We only look for
+    //  interrupts at safepoints: calls, and jumps that go backwards. Other
+    //  code only moves forwards, through a function of at most 64k, so we
+    //  still reach a safepoint soon.
+    int rc = 0;
+    while (true) {
+        byte opcode = *s_code (vm, needle);
+        if (self->tracing)
+            s_trace_step (self, needle, opcode);
+        needle++;
+        if (opcode < VM_CONSTANTS) {
+            if (self->nbr_registers)
+                s_exec_flush (self);
+            uint64_t started = self->profiling? s_now (): 0;
+            int atomic_rc = (vm->atomics [opcode]->function) (vm,
                 self->loop_fn? self->loopin: self->stdin,
-                self->stdout))
+                self->stdout);
+            //  The atomic may have switched profiling on or off
+            if (self->profiling && started)
+                s_profile_atomic (self, opcode, started);
+            if (atomic_rc)
                 break;
             self->loop_fn = false;
         }
         else
         if (opcode == VM_CALL) {
+            if (zctx_interrupted)
+                break;              //  Safepoint
             //  Address is in next 3 bytes
-            size_t address = s_decode_address (self->code + needle);
+            size_t address = s_decode_address (s_code (vm, needle));
             needle += 3;
-            assert (self->code [address] == VM_GUARD);
-            if (self->verbose)
-                printf ("CALL function=%s address=%zd stack=%zd\n",
-                        s_function_name (self, address), address, self->call_stack_ptr);
-            assert (self->call_stack_ptr < MAX_CALLS);
+            assert (*s_code (vm, address) == VM_GUARD);
+            assert (self->call_stack_ptr < self->call_stack_max);
+            if (self->profiling)
+                s_profile_frame (self->profile, self->call_stack_ptr + 1, address, s_now ());
             self->call_stack [self->call_stack_ptr++] = needle;
-            needle = s_function_body (self, address);
+            needle = s_function_body (vm, address);
         }
         else
         if (opcode == VM_RETURN) {
-            if (self->verbose)
-                printf ("RETURN stack=%zd\n", self->call_stack_ptr);
             needle = self->call_stack [--self->call_stack_ptr];
+            if (self->profiling)
+                s_profile_return (self, self->call_stack_ptr + 1);
         }
         else
         if (opcode == VM_LOOP) {
@@ -851,18 +2559,21 @@ zs_vm_run (zs_vm_t *self)
             //  - pipe op GREEDY (stdout -> loopin)
             //  - recv event from loopin (state remains on loopin)
             //  - jump to address if event <= 0
+            assert (self->loop_stack_ptr < self->loop_stack_max);
             self->loop_stack [self->loop_stack_ptr++] = self->loopin;
             self->loopin = zs_pipe_new ();
+            s_exec_flush (self);
             //  Get last phrase into loopin pipe
             zs_pipe_pull_greedy (self->loopin, self->stdout);
             //  Get event and jump if false
             int64_t event = zs_pipe_recv_whole (self->loopin);
-            if (self->verbose)
-                printf ("LOOP event=%" PRId64 "\n", event);
             if (event > 0)
                 needle += 3;        //  Skip jump address
             else {
-                needle = s_decode_address (self->code + needle);
+                needle = s_decode_address (s_code (vm, needle));
+                //  Restore previous loopin pipe, as XLOOP would
+                zs_pipe_destroy (&self->loopin);
+                self->loopin = self->loop_stack [--self->loop_stack_ptr];
             }
         }
         else
@@ -872,13 +2583,14 @@ zs_vm_run (zs_vm_t *self)
             //  - jump to address if event > 0
             //  - destroy loopin and pop saved loopin
             //  Get last phrase into loopin pipe
+            s_exec_flush (self);
             zs_pipe_pull_greedy (self->loopin, self->stdout);
             //  Get event and jump if true
             int64_t event = zs_pipe_recv_whole (self->loopin);
-            if (self->verbose)
-                printf ("XLOOP event=%" PRId64 "\n", event);
             if (event > 0) {
-                needle = s_decode_address (self->code + needle);
+                if (zctx_interrupted)
+                    break;          //  Safepoint
+                needle = s_decode_address (s_code (vm, needle));
             }
             else {
                 needle += 3;        //  Skip jump address
@@ -889,61 +2601,123 @@ zs_vm_run (zs_vm_t *self)
             }
         }
         else
+        if (opcode == VM_PLOOP) {
+            //  - pipe op GREEDY (stdout -> state)
+            //  - recv event and number of iterations from state
+            //  - run iterations on worker VMs, collecting output
+            //  - continue after the loop body
+            zs_pipe_t *state = zs_pipe_new ();
+            s_exec_flush (self);
+            zs_pipe_pull_greedy (state, self->stdout);
+            int64_t event = zs_pipe_recv_whole (state);
+            int64_t cycles = zs_pipe_recv_whole (state);
+            zs_pipe_destroy (&state);
+            size_t body = needle + 3;
+            needle = s_decode_address (s_code (vm, needle));
+            if (event > 0 && cycles > 0
+            &&  s_parallel_loop (self, body, cycles)) {
+                rc = -1;
+                break;
+            }
+        }
+        else
+        if (opcode == VM_XPLOOP) {
+            //  Worker VM has finished one iteration
+            break;
+        }
+        else
         if (opcode == VM_JUMP) {
             //  Jump unconditionally
-            needle = s_decode_address (self->code + needle);
-            if (self->verbose)
-                printf ("JUMP address=%zd\n", needle);
+            size_t target = s_decode_address (s_code (vm, needle));
+            if (target < needle && zctx_interrupted)
+                break;              //  Safepoint
+            needle = target;
         }
         else
         if (opcode == VM_JUMPEX) {
             //  We expect test value on input pipe
             int64_t event = zs_pipe_recv_whole (self->stdin);
-            if (self->verbose)
-                printf ("JUMPEX event=%" PRId64 "\n", event);
             //  Jump if next input value is zero or negative
             if (event > 0)
                 needle += 3;        //  Skip jump address
-            else
-                needle = s_decode_address (self->code + needle);
+            else {
+                size_t target = s_decode_address (s_code (vm, needle));
+                if (target < needle && zctx_interrupted)
+                    break;          //  Safepoint
+                needle = target;
+            }
+        }
+        else
+        if (opcode == VM_CONSTANTS) {
+            //  A count, then that many constants, each coded as usual
+            size_t count = *s_code (vm, needle++);
+            byte *code = s_code (vm, needle);
+            byte *start = code;
+            while (count--) {
+                byte constant = *code++;
+                if (constant == VM_WHOLE) {
+                    memcpy (&s_exec_hold (self, 'w')->whole, code, sizeof (int64_t));
+                    code += sizeof (int64_t);
+                }
+                else
+                if (constant == VM_REAL) {
+                    memcpy (&s_exec_hold (self, 'r')->real, code, sizeof (double));
+                    code += sizeof (double);
+                }
+                else {
+                    assert (constant == VM_STRING);
+                    s_exec_flush (self);
+                    zs_pipe_send_string (self->stdout, (char *) code);
+                    code += strlen ((char *) code) + 1;
+                }
+            }
+            needle += code - start;
         }
         else
         if (opcode == VM_WHOLE) {
-            int64_t whole;
-            memcpy (&whole, self->code + needle, sizeof (whole));
-            zs_pipe_send_whole (self->stdout, whole);
-            if (self->verbose)
-                printf ("WHOLE value=%" PRId64 "\n", whole);
-            needle += sizeof (whole);
+            //  Hold number constants back from stdout, in registers
+            memcpy (&s_exec_hold (self, 'w')->whole, s_code (vm, needle), sizeof (int64_t));
+            needle += sizeof (int64_t);
         }
         else
         if (opcode == VM_REAL) {
-            double real;
-            memcpy (&real, self->code + needle, sizeof (real));
-            zs_pipe_send_real (self->stdout, real);
-            if (self->verbose)
-                printf ("REAL value=%g\n", real);
-            needle += sizeof (real);
+            memcpy (&s_exec_hold (self, 'r')->real, s_code (vm, needle), sizeof (double));
+            needle += sizeof (double);
         }
         else
         if (opcode == VM_STRING) {
-            char *string = (char *) self->code + needle;
+            char *string = (char *) s_code (vm, needle);
+            s_exec_flush (self);
             zs_pipe_send_string (self->stdout, string);
-            if (self->verbose)
-                printf ("STRING value=%s\n", string);
             needle += strlen (string) + 1;
         }
         else
         if (opcode == VM_PIPE) {
             //  Later we'll rewrite the pipe API to use fixed allocations inside
             //  the VM. The current design makes it easy to develop the language.
-            byte pipe_op = self->code [needle++];
-            if (self->verbose)
-                printf ("PIPE op=%s\n", pipe_op_name [pipe_op]);
-
+            byte pipe_op = *s_code (vm, needle++);
+            if (self->nbr_registers) {
+                //  A register is the last value on stdout, and if there's
+                //  nothing before it, it's the whole phrase too. Else it's
+                //  time to send the registers on.
+                if (pipe_op == VM_PIPE_SINGLE || pipe_op == VM_PIPE_MODEST) {
+                    s_exec_pull_register (self,
+                        &self->registers [--self->nbr_registers]);
+                    continue;
+                }
+                else
+                if (pipe_op == VM_PIPE_GREEDY && zs_pipe_size (self->stdout) == 0) {
+                    size_t index;
+                    for (index = 0; index < self->nbr_registers; index++)
+                        s_exec_pull_register (self, &self->registers [index]);
+                    self->nbr_registers = 0;
+                    continue;
+                }
+                s_exec_flush (self);
+            }
             switch (pipe_op) {
                 case VM_PIPE_NEST:
-                    assert (self->nest_stack_ptr < MAX_NEST);
+                    assert (self->nest_stack_ptr < self->nest_stack_max);
                     self->nest_stack [self->nest_stack_ptr++] = self->stdout;
                     self->stdout = zs_pipe_new ();
                     break;
@@ -975,22 +2749,21 @@ zs_vm_run (zs_vm_t *self)
         }
         else
         if (opcode == VM_SENTENCE) {
-            if (self->verbose)
-                printf ("SENTENCE\n");
-            //  TODO: send results to console/actor pipe
-            //  For now zs_repl grabs results via the zs_vm_results call
+            s_exec_flush (self);
+            //  When connected, the sentence goes to another VM; otherwise
+            //  zs_repl grabs results via the zs_vm_results call
+            if (self->output && zs_pipe_send_ring (self->stdout, self->output)) {
+                rc = -1;        //  Reader has gone away
+                break;
+            }
         }
         else
         if (opcode == VM_GUARD) {
-            if (self->verbose)
-                printf ("GUARD\n");
             printf ("E: corrupt VM, aborting\n");
             assert (false);
         }
         else
         if (opcode == VM_STOP) {
-            if (self->verbose)
-                printf ("STOP\n");
             break;
         }
         else {
@@ -998,117 +2771,617 @@ zs_vm_run (zs_vm_t *self)
             break;
         }
     }
-    return 0;
-}
+    s_exec_flush (self);
 
+    //  If we stopped inside nests or loops, unwind them, so the stacks stay
+    //  within the depths the next run was sized for
+    while (self->nest_stack_ptr > nest_base) {
+        zs_pipe_destroy (&self->stdout);
+        self->stdout = self->nest_stack [--self->nest_stack_ptr];
+    }
+    while (self->loop_stack_ptr > loop_base) {
+        zs_pipe_destroy (&self->loopin);
+        self->loopin = self->loop_stack [--self->loop_stack_ptr];
+    }
+    s_running = caller;
+    return rc;
+}
 
 //  ---------------------------------------------------------------------------
-//  Return results as string, after successful execution. Caller must not
-//  modify returned value.
-//  TODO: deprected, to be replaced by sending to pipe on sentence
+//  Run last defined function, if any, in the VM. This continues forever or
+//  until the function ends. Returns 0 if stopped successfully, or -1 if
+//  stopped due to some error, or because the input ring was closed. Each run
+//  of the VM starts with clean pipes.
 
-const char *
-zs_vm_results (zs_vm_t *self)
+int
+zs_vm_run (zs_vm_t *self)
 {
-    zstr_free (&self->results);
-    self->results = zs_pipe_paste (self->stdout);
-    return self->results;
+    //  We call the last function that was defined, which is at code_head.
+    return zs_exec_run (self->exec, self->code_head);
 }
 
 
 //  ---------------------------------------------------------------------------
-//  Selftest
+//  Return the address of the last committed function, which zs_vm_run
+//  would call, or 0 if there are no functions. The address stays valid
+//  until the function is rolled back.
 
-//  These are the atomics we use in the selftest application
-static int
-s_sum (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+size_t
+zs_vm_head (zs_vm_t *self)
 {
-    if (zs_vm_probing (self))
-        zs_vm_register (self, "sum", zs_type_greedy, "Add up all the values");
-    else {
-        int64_t sum = 0;
-        while (zs_pipe_recv (input))
-            sum += zs_pipe_whole (input);
-        zs_pipe_send_whole (output, sum);
-    }
-    return 0;
+    return self->code_head;
 }
 
-static int
-s_tally (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+
+//  ---------------------------------------------------------------------------
+//  Run the committed function at the given address, as returned by
+//  zs_vm_head, in the same way as zs_vm_run.
+
+int
+zs_vm_run_function (zs_vm_t *self, size_t address)
 {
-    if (zs_vm_probing (self))
-        zs_vm_register (self, "tally", zs_type_greedy, "Eat and tally all the values");
-    else {
-        int64_t tally = 0;
-        while (zs_pipe_recv (input))
-            tally++;
-        zs_pipe_send_whole (output, tally);
-    }
-    return 0;
+    return zs_exec_run (self->exec, address);
 }
 
-static int
-s_assert (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+
+//  ---------------------------------------------------------------------------
+//  Set the number of threads that parallel atomics may use, including the
+//  calling thread. Zero means one per CPU, which is the default.
+
+void
+zs_vm_set_workers (zs_vm_t *self, size_t workers)
 {
-    if (zs_vm_probing (self))
-        zs_vm_register (self, "assert", zs_type_greedy, "Assert first two values are the same");
-    else {
-        int64_t first = zs_pipe_recv_whole (input);
-        int64_t second = zs_pipe_recv_whole (input);
-        if (first != second) {
-            printf ("E: assertion failed, %" PRId64 " != %" PRId64 "\n", first, second);
-            assert (false);
-        }
-    }
-    return 0;
+    self->workers = workers;
+    zs_pool_destroy (&self->exec->pool);
 }
 
-static int
-s_year (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+
+//  ---------------------------------------------------------------------------
+//  Set the largest function body, in bytes, that the compiler copies into
+//  its callers instead of calling. Inlined functions no longer show up in
+//  profiles or traces. Zero switches inlining off. Applies to code compiled
+//  after this call. Forks inherit the setting.
+
+void
+zs_vm_set_inline (zs_vm_t *self, size_t limit)
 {
-    if (zs_vm_probing (self))
-        zs_vm_register (self, "year", zs_type_nullary, "Tell us what year it is");
-    else
-        zs_pipe_send_whole (output, 2015);
-    return 0;
+    self->inline_max = limit;
 }
 
-static int
-s_times (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+
+//  ---------------------------------------------------------------------------
+//  Compile a call at the end of a function as a jump to the called function,
+//  so the call takes no stack. Functions reached that way no longer show up
+//  in profiles or traces. Defaults to true. Applies to code compiled after
+//  this call. Forks inherit the setting.
+
+void
+zs_vm_set_tail_calls (zs_vm_t *self, bool tail_calls)
 {
-    if (zs_vm_probing (self))
-        zs_vm_register (self, "times", zs_type_modest, "Loop N times");
-    else {
-        zs_pipe_mark (output);
-        int64_t value = zs_pipe_recv_whole (input);
-        if (value > 0) {
-            //  Send loop event 1 = continue loop
-            zs_pipe_send_whole (output, 1);
-            //  Send loop state = our next counter
-            zs_pipe_send_whole (output, value - 1);
-        }
-        else
-            //  Send loop event 0 = end loop
-            zs_pipe_send_whole (output, 0);
-    }
-    return 0;
+    self->tail_calls = tail_calls;
 }
 
 
+//  ---------------------------------------------------------------------------
+//  Work out the types of values as they flow through each function as we
+//  commit it, and call whole number variants of atomics where we can prove
+//  all input values are whole. Defaults to true. Applies to code compiled
+//  after this call. Forks inherit the setting.
+
 void
-zs_vm_test (bool verbose)
+zs_vm_set_specialize (zs_vm_t *self, bool specialize)
 {
-    printf (" * zs_vm: ");
-    if (verbose)
-        printf ("\n");
+    self->specialize = specialize;
+}
 
-    //  @selftest
-    zs_vm_t *vm = zs_vm_new ();
-    zs_vm_set_verbose (vm, verbose);
 
-    zs_vm_probe (vm, s_sum);
-    zs_vm_probe (vm, s_tally);
+//  ---------------------------------------------------------------------------
+//  Clean up each function's code as we commit it: drop pipe operations that
+//  do nothing, join runs of constants into one instruction, and thread jumps
+//  to jumps. Defaults to true. Applies to
+//  code compiled after this call. Forks inherit the setting.
+
+void
+zs_vm_set_peephole (zs_vm_t *self, bool peephole)
+{
+    self->peephole = peephole;
+}
+
+
+//  Worker contexts run the code of their VM in place, with their own pipes
+//  and stacks. Return the number of jobs we can run at once, and make sure
+//  we have that many worker contexts, with clean pipes. Worker contexts
+//  don't get their own threads; they run all the work in place, on one
+//  worker of their own.
+static size_t
+s_prepare_workers (zs_exec_t *self)
+{
+    size_t slots = 1;
+    if (!self->worker) {
+        if (!self->pool)
+            self->pool = zs_pool_new (self->vm->workers);
+        slots = zs_pool_size (self->pool);
+    }
+    if (self->nbr_clones < slots) {
+        self->clones = (zs_exec_t **) realloc (self->clones, slots * sizeof (zs_exec_t *));
+        assert (self->clones);
+        while (self->nbr_clones < slots) {
+            zs_exec_t *clone = zs_exec_new (self->vm);
+            assert (clone);
+            clone->worker = true;
+            self->clones [self->nbr_clones++] = clone;
+        }
+    }
+    size_t index;
+    for (index = 0; index < slots; index++) {
+        zs_exec_t *clone = self->clones [index];
+        zs_pipe_purge (clone->stdin);
+        zs_pipe_purge (clone->stdout);
+        zs_pipe_purge (clone->loopin);
+    }
+    return slots;
+}
+
+//  Work for one worker context; either one chunk of a pmap, which is
+//  waiting on the worker's stdout, or a range of parallel loop iterations
+typedef struct {
+    zs_exec_t *exec;                //  Worker context
+    size_t needle;                  //  Code to execute
+    int64_t index;                  //  First loop iteration, if any
+    int64_t limit;                  //  Last loop iteration + 1
+    zs_pipe_t *results;             //  Loop results, in iteration order
+    int rc;                         //  Result of execution
+} s_job_t;
+
+static void
+s_pmap_job (void *args)
+{
+    s_job_t *job = (s_job_t *) args;
+    job->rc = s_execute (job->exec, job->needle);
+}
+
+//  Each iteration starts with clean pipes and its index on stdout
+static void
+s_ploop_job (void *args)
+{
+    s_job_t *job = (s_job_t *) args;
+    zs_exec_t *exec = job->exec;
+    for (; job->index < job->limit && job->rc == 0 && !zctx_interrupted; job->index++) {
+        zs_pipe_purge (exec->stdin);
+        zs_pipe_purge (exec->loopin);
+        zs_pipe_send_whole (exec->stdout, job->index);
+        job->rc = s_execute (exec, job->needle);
+        zs_pipe_pull_count (job->results, exec->stdout, zs_pipe_size (exec->stdout));
+    }
+}
+
+//  Run jobs on the pool, or in place if we are a worker ourselves. Returns
+//  0 if all jobs succeeded, else -1.
+static int
+s_run_jobs (zs_exec_t *self, zs_pool_fn_t *fn, s_job_t *jobs, size_t nbr_jobs)
+{
+    void **args = (void **) zmalloc (nbr_jobs * sizeof (void *));
+    assert (args);
+    size_t index;
+    for (index = 0; index < nbr_jobs; index++)
+        args [index] = &jobs [index];
+    if (self->worker) {
+        for (index = 0; index < nbr_jobs; index++)
+            (fn) (args [index]);
+    }
+    else
+        zs_pool_run (self->pool, fn, args, nbr_jobs);
+    free (args);
+
+    int rc = 0;
+    for (index = 0; index < nbr_jobs; index++)
+        if (jobs [index].rc)
+            rc = -1;
+    return rc;
+}
+
+//  Run a parallel loop body for iterations 1 to cycles, and send the results
+//  to stdout in iteration order. Each worker takes a contiguous range of
+//  iterations. Returns 0 if OK, -1 if any iteration failed.
+static int
+s_parallel_loop (zs_exec_t *self, size_t body, int64_t cycles)
+{
+    size_t slots = s_prepare_workers (self);
+    size_t nbr_jobs = (uint64_t) cycles < slots? (size_t) cycles: slots;
+    s_job_t *jobs = (s_job_t *) zmalloc (nbr_jobs * sizeof (s_job_t));
+    assert (jobs);
+    int64_t index = 1;
+    size_t job_nbr;
+    for (job_nbr = 0; job_nbr < nbr_jobs; job_nbr++) {
+        s_job_t *job = &jobs [job_nbr];
+        job->exec = self->clones [job_nbr];
+        //  The body needs no more than the function it's part of
+        s_exec_fit (job->exec, self->call_stack_max - 1,
+                    self->nest_stack_max, self->loop_stack_max);
+        job->needle = body;
+        job->index = index;
+        index += cycles / nbr_jobs + ((int64_t) job_nbr < cycles % (int64_t) nbr_jobs);
+        job->limit = index;
+        job->results = zs_pipe_new ();
+    }
+    int rc = s_run_jobs (self, s_ploop_job, jobs, nbr_jobs);
+    for (job_nbr = 0; job_nbr < nbr_jobs; job_nbr++) {
+        zs_pipe_t *results = jobs [job_nbr].results;
+        zs_pipe_pull_count (self->stdout, results, zs_pipe_size (results));
+        zs_pipe_destroy (&jobs [job_nbr].results);
+    }
+    free (jobs);
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Atomic API: apply the named user function to the values on the input
+//  pipe, and send its results to the output pipe. The values are split into
+//  one chunk per worker thread, each worker runs the function on its chunk,
+//  and the results are joined in the original order. The function should
+//  treat each value independently. Worker contexts run any nested pmap on
+//  their own thread. Returns 0 if OK, or -1 if the function is not a user
+//  function or failed.
+
+int
+zs_vm_pmap (zs_vm_t *self, const char *name, zs_pipe_t *input, zs_pipe_t *output)
+{
+    size_t address = s_resolve (self, name);
+    if (address < 256)
+        return -1;              //  Not defined, or an atomic
+
+    zs_exec_t *exec = s_exec (self);
+    size_t slots = s_prepare_workers (exec);
+    size_t values = zs_pipe_size (input);
+    size_t nbr_jobs = values < slots? values: slots;
+    if (nbr_jobs == 0)
+        return 0;
+
+    //  Spread the values evenly; the first chunks take any remainder
+    s_job_t *jobs = (s_job_t *) zmalloc (nbr_jobs * sizeof (s_job_t));
+    assert (jobs);
+    size_t index;
+    s_needs_t needs;
+    s_function_needs (self, address & 0xFFFFFF, &needs);
+    for (index = 0; index < nbr_jobs; index++) {
+        jobs [index].exec = exec->clones [index];
+        s_exec_fit (jobs [index].exec, needs.calls, needs.nests, needs.loops);
+        jobs [index].needle = s_function_body (self, address & 0xFFFFFF);
+        size_t chunk = values / nbr_jobs + (index < values % nbr_jobs);
+        zs_pipe_pull_count (jobs [index].exec->stdout, input, chunk);
+    }
+    int rc = s_run_jobs (exec, s_pmap_job, jobs, nbr_jobs);
+    for (index = 0; index < nbr_jobs; index++) {
+        zs_pipe_t *results = exec->clones [index]->stdout;
+        zs_pipe_pull_count (output, results, zs_pipe_size (results));
+    }
+    free (jobs);
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return results as string, after successful execution. Caller must not
+//  modify returned value.
+//  TODO: deprected, to be replaced by sending to pipe on sentence
+
+const char *
+zs_vm_results (zs_vm_t *self)
+{
+    return zs_exec_results (self->exec);
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Create a new execution context for the VM's code. Many contexts may run
+//  the same VM at once, each on its own thread, as long as nothing compiles
+//  into the VM or rolls it back meanwhile. Destroy all contexts before the
+//  VM. Returns the reference if successful, or NULL if construction failed
+//  due to lack of available memory.
+
+zs_exec_t *
+zs_exec_new (zs_vm_t *vm)
+{
+    zs_exec_t *self = (zs_exec_t *) zmalloc (sizeof (zs_exec_t));
+    if (self) {
+        self->vm = vm;
+        self->stdin = zs_pipe_new ();
+        self->stdout = zs_pipe_new ();
+        self->loopin = zs_pipe_new ();
+    }
+    return self;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Destroy the execution context and free all memory used by it.
+
+void
+zs_exec_destroy (zs_exec_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        zs_exec_t *self = *self_p;
+        zstr_free (&self->results);
+        zs_pipe_destroy (&self->stdin);
+        zs_pipe_destroy (&self->stdout);
+        zs_pipe_destroy (&self->loopin);
+        free (self->nest_stack);
+        free (self->loop_stack);
+        free (self->call_stack);
+        s_profile_destroy (&self->profile);
+        zs_trace_destroy (&self->trace);
+        zs_pool_destroy (&self->pool);
+        while (self->nbr_clones)
+            zs_exec_destroy (&self->clones [--self->nbr_clones]);
+        free (self->clones);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Run the committed function at the given address, as returned by
+//  zs_vm_head, in this context. Returns 0 if stopped successfully, or -1
+//  if stopped due to some error, or because the input ring was closed.
+//  Each run starts with clean pipes.
+
+int
+zs_exec_run (zs_exec_t *self, size_t address)
+{
+    zs_vm_t *vm = self->vm;
+    assert (!vm->checkpoint);
+    assert (!address || *s_code (vm, address) == VM_GUARD);
+
+    size_t needle = s_function_body (vm, address);
+    if (vm->verbose || self->verbose)
+        printf ("D [%04zd]: run '%s'\n", needle, s_function_name (vm, address));
+    s_exec_set_tracing (self);
+    s_needs_t needs;
+    s_function_needs (vm, address, &needs);
+    s_exec_fit (self, needs.calls, needs.nests, needs.loops);
+
+    //  Clean pipes before each run
+    zs_pipe_purge (self->stdin);
+    zs_pipe_purge (self->stdout);
+    zs_pipe_purge (self->loopin);
+
+    //  Input from another VM arrives as though it were typed in
+    if (self->input && zs_pipe_recv_ring (self->stdout, self->input))
+        return -1;
+
+    //  The function we run is timed in frame zero
+    if (self->profiling)
+        s_profile_frame (self->profile, 0, address, s_now ());
+    int rc = s_execute (self, needle);
+    if (self->profiling)
+        s_profile_return (self, 0);
+    return rc;
+}
+
+
+//  ---------------------------------------------------------------------------
+//  Return results of the last run as string. Caller must not modify returned
+//  value.
+
+const char *
+zs_exec_results (zs_exec_t *self)
+{
+    zstr_free (&self->results);
+    self->results = zs_pipe_paste (self->stdout);
+    return self->results;
+}
+//  ---------------------------------------------------------------------------
+//  Selftest
+
+//  These are the atomics we use in the selftest application
+static int
+s_sum_whole (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    int64_t sum = 0;
+    while (zs_pipe_recv (input))
+        sum += zs_pipe_whole (input);
+    zs_pipe_send_whole (output, sum);
+    return 0;
+}
+
+static int
+s_sum (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "sum", zs_type_greedy, "Add up all the values");
+        zs_vm_register_signature (self, "wrs", "w", 1, zs_effect_pure);
+        zs_vm_register_whole (self, s_sum_whole);
+    }
+    else
+        s_sum_whole (self, input, output);
+    return 0;
+}
+
+static int
+s_tally (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "tally", zs_type_greedy, "Eat and tally all the values");
+        zs_vm_register_signature (self, "wrs", "w", 1, zs_effect_pure);
+    }
+    else {
+        int64_t tally = 0;
+        while (zs_pipe_recv (input))
+            tally++;
+        zs_pipe_send_whole (output, tally);
+    }
+    return 0;
+}
+
+static int
+s_assert (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "assert", zs_type_greedy, "Assert first two values are the same");
+        zs_vm_register_signature (self, "wrs", "", 0, zs_effect_writes);
+    }
+    else {
+        int64_t first = zs_pipe_recv_whole (input);
+        int64_t second = zs_pipe_recv_whole (input);
+        if (first != second) {
+            printf ("E: assertion failed, %" PRId64 " != %" PRId64 "\n", first, second);
+            assert (false);
+        }
+    }
+    return 0;
+}
+
+static int
+s_year (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "year", zs_type_nullary, "Tell us what year it is");
+        //  Value types are only 'w', 'r', and 's'
+        assert (zs_vm_register_signature (self, "", "x", 1, zs_effect_reads) == -1);
+        //  Nullary atomics take no input
+        assert (zs_vm_register_signature (self, "w", "w", 1, zs_effect_reads) == -1);
+        zs_vm_register_signature (self, "", "w", 1, zs_effect_reads);
+    }
+    else
+        zs_pipe_send_whole (output, 2015);
+    return 0;
+}
+
+//  Switches off pipe tracing, and sends what connect returns
+static int
+s_detach (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "detach", zs_type_nullary, "Stop tracing, disconnect");
+        zs_vm_register_signature (self, "", "w", 1, zs_effect_writes);
+    }
+    else {
+        zs_vm_trace_pipes (self, false);
+        zs_pipe_send_whole (output, zs_vm_connect (self, ""));
+    }
+    return 0;
+}
+
+static int
+s_times (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    if (zs_vm_probing (self)) {
+        zs_vm_register (self, "times", zs_type_modest, "Loop N times");
+        zs_vm_register_signature (self, "w", "w", ZS_ARITY_ANY, zs_effect_pure);
+    }
+    else {
+        zs_pipe_mark (output);
+        int64_t value = zs_pipe_recv_whole (input);
+        if (value > 0) {
+            //  Send loop event 1 = continue loop
+            zs_pipe_send_whole (output, 1);
+            //  Send loop state = our next counter
+            zs_pipe_send_whole (output, value - 1);
+        }
+        else
+            //  Send loop event 0 = end loop
+            zs_pipe_send_whole (output, 0);
+    }
+    return 0;
+}
+
+//  Loop function that takes no input, and runs a loop once
+static int
+s_flip (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output)
+{
+    static bool flipped = false;
+    if (zs_vm_probing (self))
+        zs_vm_register (self, "flip", zs_type_nullary, "Continue, then stop");
+    else {
+        flipped = !flipped;
+        zs_pipe_mark (output);
+        zs_pipe_send_whole (output, flipped);
+    }
+    return 0;
+}
+
+//  Return the last run's trace as text, or as JSON; caller must free it
+static char *
+s_trace_text (zs_vm_t *vm, bool json)
+{
+    FILE *file = tmpfile ();
+    assert (file);
+    zs_vm_trace_print (vm, file, json);
+    long size = ftell (file);
+    rewind (file);
+    char *buffer = (char *) zmalloc (size + 1);
+    assert (buffer);
+    buffer [fread (buffer, 1, size, file)] = 0;
+    fclose (file);
+    return buffer;
+}
+
+//  Consumer VM for the ring test, running in its own thread; it sums each
+//  sentence that arrives, and adds up all the sums
+typedef struct {
+    zs_ring_t *ring;
+    int64_t total;
+    size_t sentences;
+} s_consumer_t;
+
+static void *
+s_consumer (void *args)
+{
+    s_consumer_t *consumer = (s_consumer_t *) args;
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    zs_vm_set_input (vm, consumer->ring);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_inline (vm, "sum");
+    zs_vm_commit (vm);
+    while (zs_vm_run (vm) == 0) {
+        consumer->total += atoll (zs_vm_results (vm));
+        consumer->sentences++;
+    }
+    zs_vm_destroy (&vm);
+    return NULL;
+}
+
+//  Runs the head function of a shared VM many times, in its own context
+typedef struct {
+    zs_vm_t *vm;
+    size_t runs;
+} s_runner_t;
+
+static void *
+s_runner (void *args)
+{
+    s_runner_t *runner = (s_runner_t *) args;
+    zs_exec_t *exec = zs_exec_new (runner->vm);
+    size_t runs;
+    for (runs = 0; runs < 1000; runs++) {
+        assert (zs_exec_run (exec, zs_vm_head (runner->vm)) == 0);
+        if (streq (zs_exec_results (exec), "6 3"))
+            runner->runs++;
+    }
+    zs_exec_destroy (&exec);
+    return NULL;
+}
+
+
+void
+zs_vm_test (bool verbose)
+{
+    printf (" * zs_vm: ");
+    if (verbose)
+        printf ("\n");
+
+    //  @selftest
+    size_t runs;
+    zs_vm_t *vm = zs_vm_new ();
+    zs_vm_set_verbose (vm, verbose);
+
+    zs_vm_probe (vm, s_sum);
+    zs_vm_probe (vm, s_tally);
     zs_vm_probe (vm, s_assert);
     zs_vm_probe (vm, s_year);
     zs_vm_probe (vm, s_times);
@@ -1228,6 +3501,645 @@ zs_vm_test (bool verbose)
         nbr_functions++;
     }
     assert (nbr_functions == 5);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Map a function over chunks of values, across worker threads
+    //  chunk: (tally)
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_tally);
+    zs_vm_set_workers (vm, 4);
+    zs_vm_compile_define (vm, "chunk");
+    zs_vm_compile_inline (vm, "tally");
+    zs_vm_commit (vm);
+
+    zs_pipe_t *input = zs_pipe_new ();
+    zs_pipe_t *output = zs_pipe_new ();
+    int64_t value;
+    for (value = 1; value <= 10; value++)
+        zs_pipe_send_whole (input, value);
+    assert (zs_vm_pmap (vm, "chunk", input, output) == 0);
+    assert (zs_pipe_size (input) == 0);
+    char *results = zs_pipe_paste (output);
+    assert (streq (results, "3 3 2 2"));
+    zstr_free (&results);
+    //  Atomics and unknown names can't be mapped
+    assert (zs_vm_pmap (vm, "tally", input, output) == -1);
+    assert (zs_vm_pmap (vm, "nosuchfunction", input, output) == -1);
+
+    //  Workers can't change the shared VM, so connect fails there; each
+    //  chunk passes its value through, and adds connect's -1
+    //  detacher: (detach)
+    zs_vm_probe (vm, s_detach);
+    zs_vm_compile_define (vm, "detacher");
+    zs_vm_compile_inline (vm, "detach");
+    zs_vm_commit (vm);
+    for (value = 1; value <= 4; value++)
+        zs_pipe_send_whole (input, value);
+    assert (zs_vm_pmap (vm, "detacher", input, output) == 0);
+    results = zs_pipe_paste (output);
+    assert (streq (results, "1 -1 2 -1 3 -1 4 -1"));
+    zstr_free (&results);
+    assert (zs_vm_connect (vm, "") == 0);
+    zs_pipe_destroy (&input);
+    zs_pipe_destroy (&output);
+
+    //  --------------------------------------------------------------------
+    //  Run loop iterations on worker threads, nested loops in place
+    //  ploop: (10 parallel { year tally } 3 parallel { 2 parallel {} })
+
+    zs_vm_probe (vm, s_year);
+    zs_vm_compile_define (vm, "ploop");
+    zs_vm_compile_whole  (vm, 10);
+    zs_vm_compile_inline (vm, "parallel");
+    zs_vm_compile_loop   (vm, "parallel");
+    zs_vm_compile_inline (vm, "year");
+    zs_vm_compile_inline (vm, "tally");
+    zs_vm_compile_xloop  (vm);
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_compile_inline (vm, "parallel");
+    zs_vm_compile_loop   (vm, "parallel");
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_inline (vm, "parallel");
+    zs_vm_compile_loop   (vm, "parallel");
+    zs_vm_compile_xloop  (vm);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "2 2 2 2 2 2 2 2 2 2, 1 1 2 2 1 2 3 1 2"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Fork two sessions from a VM holding a shared library
+    //  library: two: (2) pair: (two two)
+    //  first: two: (5) main: (two pair)
+    //  second: main: (pair sum)
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    zs_vm_compile_define (vm, "two");
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "pair");
+    zs_vm_compile_inline (vm, "two");
+    zs_vm_compile_inline (vm, "two");
+    zs_vm_commit (vm);
+
+    zs_vm_t *first = zs_vm_fork (vm);
+    zs_vm_t *second = zs_vm_fork (vm);
+    zs_vm_compile_define (first, "two");
+    zs_vm_compile_whole  (first, 5);
+    zs_vm_commit (first);
+    zs_vm_compile_define (first, "main");
+    zs_vm_compile_inline (first, "two");
+    zs_vm_compile_inline (first, "pair");
+    zs_vm_commit (first);
+    assert (zs_vm_run (first) == 0);
+    //  The library keeps calling its own two
+    assert (streq (zs_vm_results (first), "5 2 2"));
+
+    zs_vm_compile_define (second, "main");
+    zs_vm_compile_inline (second, "pair");
+    zs_vm_compile_inline (second, "sum");
+    zs_vm_commit (second);
+    assert (zs_vm_run (second) == 0);
+    assert (streq (zs_vm_results (second), "4"));
+
+    //  Children see their own functions first, then the library's
+    assert (streq (zs_vm_function_first (first), "main"));
+    assert (streq (zs_vm_function_next (first), "two"));
+    assert (streq (zs_vm_function_next (first), "pair"));
+    assert (streq (zs_vm_function_next (first), "two"));
+
+    //  Children can only roll back their own functions
+    assert (zs_vm_rollback (first) == 0);
+    assert (zs_vm_rollback (first) == 0);
+    assert (zs_vm_rollback (first) == -1);
+    assert (streq (zs_vm_function_first (first), "pair"));
+    zs_vm_destroy (&first);
+    zs_vm_destroy (&second);
+
+    //  Once the children are gone, the parent can compile again
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_inline (vm, "pair");
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "2 2"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Profile calls to atomics and functions
+    //  two: (year) pair: (two two tally) main: (pair pair)
+
+    vm = zs_vm_new ();
+    //  Profiles count calls, so we don't inline or jump over them
+    zs_vm_set_inline (vm, 0);
+    zs_vm_set_tail_calls (vm, false);
+    zs_vm_probe (vm, s_tally);
+    zs_vm_probe (vm, s_year);
+    zs_vm_compile_define (vm, "two");
+    zs_vm_compile_inline (vm, "year");
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "pair");
+    zs_vm_compile_inline (vm, "two");
+    zs_vm_compile_inline (vm, "two");
+    zs_vm_compile_inline (vm, "tally");
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_inline (vm, "pair");
+    zs_vm_compile_inline (vm, "pair");
+    zs_vm_commit (vm);
+
+    //  Nothing is counted until profiling is switched on
+    zs_vm_run (vm);
+    assert (zs_vm_profile_first (vm) == NULL);
+    zs_vm_set_profile (vm, true);
+    for (runs = 0; runs < 3; runs++)
+        zs_vm_run (vm);
+    zs_vm_set_profile (vm, false);
+    zs_vm_run (vm);
+
+    size_t entries = 0;
+    uint64_t nanos = UINT64_MAX;
+    const char *name = zs_vm_profile_first (vm);
+    while (name) {
+        uint64_t calls = zs_vm_profile_calls (vm);
+        if (streq (name, "main"))
+            assert (calls == 3);
+        else
+        if (streq (name, "pair") || streq (name, "tally"))
+            assert (calls == 6);
+        else
+        if (streq (name, "two") || streq (name, "year"))
+            assert (calls == 12);
+        else
+            assert (false);
+        //  Most expensive entries come first
+        assert (zs_vm_profile_nanos (vm) <= nanos);
+        nanos = zs_vm_profile_nanos (vm);
+        entries++;
+        name = zs_vm_profile_next (vm);
+    }
+    assert (entries == 5);
+
+    //  Trace the last instructions, and dump them as text and JSON
+    zs_vm_set_trace (vm, 8);
+    zs_vm_run (vm);
+    char *buffer = s_trace_text (vm, false);
+    //  The run ends: ... GREEDY tally RETURN RETURN STOP
+    assert (strstr (buffer, "tally stdin=3 stdout=0"));
+    assert (strstr (buffer, "STOP stdin=0 stdout=1"));
+    free (buffer);
+    buffer = s_trace_text (vm, true);
+    assert (strstr (buffer, "\"ph\":\"E\""));
+    free (buffer);
+    zs_vm_set_trace (vm, 0);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Small functions are inlined, with their loops and menus intact
+    //  once: (3 times { 1 }) pick: (1 [ 2 ]) main: (once pick once)
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_times);
+    zs_vm_compile_define (vm, "once");
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_compile_inline (vm, "times");
+    zs_vm_compile_loop   (vm, "times");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "pick");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_menu   (vm);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_xmenu  (vm);
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_inline (vm, "once");
+    zs_vm_compile_inline (vm, "pick");
+    zs_vm_compile_inline (vm, "once");
+    zs_vm_commit (vm);
+    zs_vm_set_profile (vm, true);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1 1 1 2 1 1 1"));
+    //  Only main and the atomics were called
+    name = zs_vm_profile_first (vm);
+    while (name) {
+        assert (streq (name, "main") || streq (name, "times"));
+        name = zs_vm_profile_next (vm);
+    }
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  The peephole pass joins runs of constants into one instruction
+    //  main: (1 2.5 <three> 4)
+
+    vm = zs_vm_new ();
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_real   (vm, 2.5);
+    zs_vm_compile_string (vm, "three");
+    zs_vm_compile_whole  (vm, 4);
+    zs_vm_commit (vm);
+    zs_vm_set_trace (vm, 16);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1 2.5 three 4"));
+    buffer = s_trace_text (vm, false);
+    assert (strstr (buffer, "CONSTANTS"));
+    assert (!strstr (buffer, "WHOLE"));
+    free (buffer);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  The peephole pass keeps empty phrases, which pulls can see
+    //  main: (1, , 2)
+
+    vm = zs_vm_new ();
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1,, 2"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  The peephole pass drops UNLOOP before nullary loop functions
+    //  main: (flip { 7 })
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_flip);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_inline (vm, "flip");
+    zs_vm_compile_loop   (vm, "flip");
+    zs_vm_compile_whole  (vm, 7);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_commit (vm);
+    zs_vm_set_trace (vm, 16);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "7"));
+    buffer = s_trace_text (vm, false);
+    assert (strstr (buffer, "flip"));
+    assert (!strstr (buffer, "UNLOOP"));
+    free (buffer);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  The peephole pass threads a menu's jump through a tail call
+    //  five: (5) main: (0 [ 2 ] five)
+
+    vm = zs_vm_new ();
+    zs_vm_set_inline (vm, 0);
+    zs_vm_compile_define (vm, "five");
+    zs_vm_compile_whole  (vm, 5);
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 0);
+    zs_vm_compile_menu   (vm);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_xmenu  (vm);
+    zs_vm_compile_inline (vm, "five");
+    zs_vm_commit (vm);
+    zs_vm_set_trace (vm, 16);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "5"));
+    buffer = s_trace_text (vm, false);
+    assert (strstr (buffer, "JUMPEX"));
+    assert (!strstr (buffer, "JUMP "));
+    free (buffer);
+
+    //  A menu that ends its function exits to the RETURN, and not through
+    //  a stale tail call that a rolled back definition left at that address
+    //  main: (0 [ 2 ])
+    assert (zs_vm_rollback (vm) == 0);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 0);
+    zs_vm_compile_menu   (vm);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_xmenu  (vm);
+    assert (*s_code (vm, vm->code_size) == VM_JUMP);
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), ""));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Stacks grow as deep as the code needs
+    //  deep: (1) deep: (deep) ... main: (sum (sum (... deep)))
+
+    vm = zs_vm_new ();
+    zs_vm_set_inline (vm, 0);
+    zs_vm_set_tail_calls (vm, false);
+    zs_vm_probe (vm, s_sum);
+    zs_vm_compile_define (vm, "deep");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_commit (vm);
+    size_t depth;
+    for (depth = 0; depth < 1000; depth++) {
+        zs_vm_compile_define (vm, "deep");
+        zs_vm_compile_inline (vm, "deep");
+        zs_vm_commit (vm);
+    }
+    zs_vm_compile_define (vm, "main");
+    for (depth = 0; depth < 1000; depth++)
+        zs_vm_compile_nest (vm, "sum");
+    zs_vm_compile_inline (vm, "deep");
+    for (depth = 0; depth < 1000; depth++)
+        zs_vm_compile_xnest (vm);
+    zs_vm_commit (vm);
+    zs_vm_set_profile (vm, true);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1"));
+    //  The verifier counted main's frame, and one for each deep
+    s_needs_t needs;
+    s_function_needs (vm, zs_vm_head (vm), &needs);
+    assert (needs.calls == 1001);
+    assert (needs.nests == 1000);
+    assert (needs.loops == 0);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  The verifier rejects code the compiler should never produce
+
+    vm = zs_vm_new ();
+    byte address [3];
+    size_t body;
+    assert (vm->nbr_atomics < VM_CONSTANTS - 1);
+
+    //  A call to something that isn't a function
+    zs_vm_compile_define (vm, "bad");
+    s_encode_address (address, 1);
+    s_emit (vm, VM_CALL);
+    s_emit_data (vm, address, 3);
+    s_emit (vm, VM_RETURN);
+    assert (streq (s_verify (vm, &needs), "call to unknown function"));
+    assert (zs_vm_rollback (vm) == 0);
+
+    //  A nest that never ends
+    zs_vm_compile_define (vm, "bad");
+    s_emit (vm, VM_PIPE);
+    s_emit (vm, VM_PIPE_NEST);
+    s_emit (vm, VM_RETURN);
+    assert (streq (s_verify (vm, &needs), "stacks don't balance"));
+    assert (zs_vm_rollback (vm) == 0);
+
+    //  A jump into its own address bytes
+    zs_vm_compile_define (vm, "bad");
+    body = s_function_body (vm, vm->checkpoint);
+    s_encode_address (address, body + 1);
+    s_emit (vm, VM_JUMP);
+    s_emit_data (vm, address, 3);
+    s_emit (vm, VM_RETURN);
+    assert (streq (s_verify (vm, &needs), "jump into the middle of an instruction"));
+    assert (zs_vm_rollback (vm) == 0);
+
+    //  A loop that goes back without passing a safepoint
+    zs_vm_compile_define (vm, "bad");
+    body = s_function_body (vm, vm->checkpoint);
+    s_encode_address (address, body);
+    s_emit (vm, VM_LOOP);
+    s_emit_data (vm, address, 3);
+    s_emit (vm, VM_RETURN);
+    assert (streq (s_verify (vm, &needs), "loop jumps backwards"));
+    assert (zs_vm_rollback (vm) == 0);
+
+    //  An atomic that was never registered
+    zs_vm_compile_define (vm, "bad");
+    s_emit (vm, VM_CONSTANTS - 1);
+    s_emit (vm, VM_RETURN);
+    assert (streq (s_verify (vm, &needs), "invalid instruction"));
+    assert (zs_vm_rollback (vm) == 0);
+
+    //  Commit fails on invalid code, and leaves it for us to roll back
+    zs_vm_compile_define (vm, "bad");
+    s_emit (vm, VM_PIPE);
+    s_emit (vm, VM_PIPE_NEST);
+    assert (zs_vm_commit (vm) == -1);
+    assert (zs_vm_rollback (vm) == 0);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  A loop that doesn't run at all leaves the loop stack as it was
+    //  main: (2 times { 0 times { 7 } 1 })
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_times);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_inline (vm, "times");
+    zs_vm_compile_loop   (vm, "times");
+    zs_vm_compile_whole  (vm, 0);
+    zs_vm_compile_inline (vm, "times");
+    zs_vm_compile_loop   (vm, "times");
+    zs_vm_compile_whole  (vm, 7);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1 1"));
+
+    //  An interrupt stops the run at the next safepoint
+    //  main: (1000000000 times { 1 })
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 1000000000);
+    zs_vm_compile_inline (vm, "times");
+    zs_vm_compile_loop   (vm, "times");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_xloop  (vm);
+    zs_vm_commit (vm);
+    zctx_interrupted = 1;
+    assert (zs_vm_run (vm) == 0);
+    zctx_interrupted = 0;
+    assert (streq (zs_vm_results (vm), "1"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Constants held in registers reach atomics as though sent to stdout
+    //  main: (1 2 3 4 5 6 sum 2.5 sum, 7 sum) main: (3 4 sum)
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    zs_vm_compile_define (vm, "main");
+    for (depth = 1; depth <= 6; depth++)
+        zs_vm_compile_whole (vm, depth);
+    zs_vm_compile_inline (vm, "sum");
+    zs_vm_compile_real   (vm, 2.5);
+    zs_vm_compile_inline (vm, "sum");
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_whole  (vm, 7);
+    zs_vm_compile_inline (vm, "sum");
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "24 7"));
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_compile_whole  (vm, 4);
+    zs_vm_compile_inline (vm, "sum");
+    zs_vm_commit (vm);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "7"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Atomics that only get whole numbers call their whole variant
+    //  main: (sum (1 2 3)) main: (sum (1 1.5 2)) main: (sum (1 2 3))
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    name = zs_vm_function_first (vm);
+    while (name) {
+        assert (!streq (name, "sum:whole"));
+        name = zs_vm_function_next (vm);
+    }
+    for (runs = 0; runs < 3; runs++) {
+        if (runs == 2)
+            zs_vm_set_specialize (vm, false);
+        zs_vm_compile_define (vm, "main");
+        zs_vm_compile_nest   (vm, "sum");
+        zs_vm_compile_whole  (vm, 1);
+        if (runs == 1)
+            zs_vm_compile_real (vm, 1.5);
+        zs_vm_compile_whole  (vm, 2);
+        if (runs != 1)
+            zs_vm_compile_whole (vm, 3);
+        zs_vm_compile_xnest  (vm);
+        zs_vm_commit (vm);
+        zs_vm_set_trace (vm, 64);
+        assert (zs_vm_run (vm) == 0);
+        assert (streq (zs_vm_results (vm), runs == 1? "5": "6"));
+        buffer = s_trace_text (vm, false);
+        assert (!strstr (buffer, "sum:whole") == (runs > 0));
+        free (buffer);
+    }
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Signatures tell the types pass what atomics send
+    //  main: (sum (tally (1 2.5) 3))
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    zs_vm_probe (vm, s_tally);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_nest   (vm, "sum");
+    zs_vm_compile_nest   (vm, "tally");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_real   (vm, 2.5);
+    zs_vm_compile_xnest  (vm);
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_compile_xnest  (vm);
+    zs_vm_commit (vm);
+    zs_vm_set_trace (vm, 64);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "5"));
+    buffer = s_trace_text (vm, false);
+    assert (strstr (buffer, "sum:whole"));
+    free (buffer);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Trailing calls become jumps, so long chains run in constant stack
+    //  deep: (1) deep: (deep) ... main: (deep)
+
+    vm = zs_vm_new ();
+    zs_vm_set_inline (vm, 0);
+    zs_vm_compile_define (vm, "deep");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_commit (vm);
+    for (depth = 0; depth < 1000; depth++) {
+        zs_vm_compile_define (vm, "deep");
+        zs_vm_compile_inline (vm, "deep");
+        zs_vm_commit (vm);
+    }
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_inline (vm, "deep");
+    zs_vm_commit (vm);
+    zs_vm_set_trace (vm, 2048);
+    assert (zs_vm_run (vm) == 0);
+    assert (streq (zs_vm_results (vm), "1"));
+    buffer = s_trace_text (vm, false);
+    //  Trace lines indent two spaces per call depth; we never go deeper
+    //  than the one frame that main runs in
+    assert (strstr (buffer, "JUMP"));
+    assert (!strstr (buffer, ":     "));
+    free (buffer);
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Run one VM's code from many threads at once, each in its own context
+    //  triple: (1 2 3) main: (sum (triple) tally (triple))
+
+    vm = zs_vm_new ();
+    zs_vm_probe (vm, s_sum);
+    zs_vm_probe (vm, s_tally);
+    zs_vm_compile_define (vm, "triple");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_commit (vm);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_nest   (vm, "sum");
+    zs_vm_compile_inline (vm, "triple");
+    zs_vm_compile_xnest  (vm);
+    zs_vm_compile_nest   (vm, "tally");
+    zs_vm_compile_inline (vm, "triple");
+    zs_vm_compile_xnest  (vm);
+    zs_vm_commit (vm);
+
+    s_runner_t runners [4];
+    pthread_t threads [4];
+    size_t index;
+    for (index = 0; index < 4; index++) {
+        runners [index].vm = vm;
+        runners [index].runs = 0;
+        pthread_create (&threads [index], NULL, s_runner, &runners [index]);
+    }
+    //  The VM's own context is independent of the others
+    assert (zs_vm_run (vm) == 0);
+    for (index = 0; index < 4; index++) {
+        pthread_join (threads [index], NULL);
+        assert (runners [index].runs == 1000);
+    }
+    assert (streq (zs_vm_results (vm), "6 3"));
+    zs_vm_destroy (&vm);
+
+    //  --------------------------------------------------------------------
+    //  Connect two VMs running on different threads through a ring
+    //  main: (1 2 3, 4 5)
+
+    s_consumer_t consumer = { zs_ring_new (64), 0, 0 };
+    pthread_t thread;
+    pthread_create (&thread, NULL, s_consumer, &consumer);
+
+    vm = zs_vm_new ();
+    zs_vm_attach (vm, "summer", consumer.ring);
+    assert (zs_vm_connect (vm, "nosuchport") == -1);
+    assert (zs_vm_connect (vm, "summer") == 0);
+    zs_vm_compile_define (vm, "main");
+    zs_vm_compile_whole  (vm, 1);
+    zs_vm_compile_whole  (vm, 2);
+    zs_vm_compile_whole  (vm, 3);
+    zs_vm_compile_phrase (vm);
+    zs_vm_compile_whole  (vm, 4);
+    zs_vm_compile_whole  (vm, 5);
+    zs_vm_compile_sentence (vm);
+    zs_vm_commit (vm);
+    for (runs = 0; runs < 1000; runs++) {
+        zs_vm_run (vm);
+        //  Output went to the other VM, not to us
+        assert (streq (zs_vm_results (vm), ""));
+    }
+    zs_ring_close (consumer.ring);
+    pthread_join (thread, NULL);
+    assert (consumer.sentences == 1000);
+    assert (consumer.total == 15000);
+    zs_ring_destroy (&consumer.ring);
 
     zs_vm_destroy (&vm);
     //  @end
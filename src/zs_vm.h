@@ -23,6 +23,9 @@ extern "C" {
 #ifndef ZS_VM_T_DEFINED
 typedef struct _zs_vm_t zs_vm_t;
 #endif
+#ifndef ZS_EXEC_T_DEFINED
+typedef struct _zs_exec_t zs_exec_t;
+#endif
 
 //  Atomic function types
 typedef enum {
@@ -42,6 +45,23 @@ typedef enum {
     zs_type_unknown
 } zs_type_t;
 
+//  What an atomic does, besides send output from its input
+typedef enum {
+    //  A pure function's output depends only on its input, so the compiler
+    //  may fold, drop, or reorder calls to it. An example is "sum".
+    zs_effect_pure,
+    //  A reading function also depends on the world outside, e.g. the time,
+    //  so two calls with the same input may give different results.
+    zs_effect_reads,
+    //  A writing function changes the world outside, or may fail, so every
+    //  call must run, in order. An example is "debug".
+    zs_effect_writes
+} zs_effect_t;
+
+//  Output arities for atomics that don't send a fixed number of values
+#define ZS_ARITY_EACH   -1      //  One value for each value it takes
+#define ZS_ARITY_ANY    -2      //  Any number of values, and phrase marks
+
 
 //  Virtual machine atomic function type
 typedef int (zs_vm_fn_t) (zs_vm_t *self, zs_pipe_t *input, zs_pipe_t *output);
@@ -56,6 +76,15 @@ zs_vm_t *
 void
     zs_vm_destroy (zs_vm_t **self_p);
 
+//  Create a child VM that shares this VM's compiled code and atomics, read
+//  only. The child compiles its own functions into a private overlay, which
+//  continues the parent's address space, and resolves names there first.
+//  The parent must not compile, roll back, or be destroyed while it has
+//  children; it may fork and run from many threads. Returns the reference if
+//  successful, or NULL if construction failed due to lack of memory.
+zs_vm_t *
+    zs_vm_fork (zs_vm_t *self);
+
 //  Probe atomic to ask it to register itself; we use a self-registration
 //  system where all information about an atomic is encapsulated in its
 //  source code, rather than spread throughout the codebase. It's valid to
@@ -75,6 +104,29 @@ bool
 int
     zs_vm_register (zs_vm_t *self, const char *name, zs_type_t type, const char *hint);
 
+//  Primitive declares its signature, after zs_vm_register and before any
+//  zs_vm_register_whole. This is only valid if zs_vm_probing () is true.
+//  Input and output are the value types it takes and sends, as a string of
+//  'w', 'r', and 's'. Arity is how many values it sends, or ZS_ARITY_EACH,
+//  or ZS_ARITY_ANY. A primitive that doesn't declare a signature takes and
+//  sends any type, has any arity, and writes. Nullary primitives take no
+//  input, so their input must be empty. The signature applies to every name
+//  the primitive registered. Returns 0 if the signature is valid, -1 if not.
+int
+    zs_vm_register_signature (zs_vm_t *self, const char *input, const char *output,
+                              int arity, zs_effect_t effect);
+
+//  Primitive registers a variant of itself that only handles whole numbers.
+//  This is only valid if zs_vm_probing () is true, after zs_vm_register. When
+//  the compiler can prove that all input values are whole, it calls the
+//  variant instead. Given only whole numbers, the variant must do what the
+//  primitive does, consume all its input, and send only whole numbers. The
+//  variant applies to every name the primitive registered, and has the
+//  primitive's signature, for whole numbers. Returns 0 if registration
+//  worked, -1 if it failed due to an internal error.
+int
+    zs_vm_register_whole (zs_vm_t *self, zs_vm_fn_t *variant);
+
 //  Compile a whole number constant into the virtual machine.
 //  Whole numbers are stored thus:
 //      [VM_WHOLE][8 bytes in host format]
@@ -91,12 +143,19 @@ void
 void
     zs_vm_compile_string (zs_vm_t *self, const char *string);
 
+//  Compile a string constant of the given size into the virtual machine;
+//  the string does not need to be null-terminated.
+void
+    zs_vm_compile_slice (zs_vm_t *self, const char *string, size_t size);
+
 //  Compile a new function definition; end with a commit.
 void
     zs_vm_compile_define (zs_vm_t *self, const char *name);
 
-//  Close the current function definition.
-void
+//  Close the current function definition, and verify its code. Returns 0
+//  if OK, -1 if the code is invalid; the definition then stays open, and
+//  the caller should roll it back.
+int
     zs_vm_commit (zs_vm_t *self);
 
 //  Cancel the current or last function definition and reset the virtual
@@ -169,6 +228,45 @@ const char *
 void
     zs_vm_set_verbose (zs_vm_t *self, bool verbose);
 
+//  Atomic API: keep a trace of the last limit instructions executed, in a
+//  ring of binary events; a limit of zero switches tracing off. Starts a
+//  new trace each time. If the process aborts while the trace is on, it
+//  prints the trace to stderr.
+void
+    zs_vm_set_trace (zs_vm_t *self, size_t limit);
+
+//  Print the trace ring to the file, oldest instruction first, as text or as
+//  Chrome trace event JSON. Prints nothing if tracing is off.
+void
+    zs_vm_trace_print (zs_vm_t *self, FILE *file, bool json);
+
+//  Atomic API: switch execution profiling on or off. Switching it on starts
+//  a new profile. The profile counts calls and time spent in each atomic,
+//  and in each user function including the functions it calls. Switching
+//  profiling off keeps the profile, for reporting.
+void
+    zs_vm_set_profile (zs_vm_t *self, bool profile);
+
+//  Return the most expensive profile entry, by total time; use with next to
+//  iterate through the profile, and zs_vm_profile_calls/nanos to read the
+//  current entry. Returns the atomic or function name, or NULL if nothing
+//  has been profiled.
+const char *
+    zs_vm_profile_first (zs_vm_t *self);
+
+//  Return the next profile entry, in order of decreasing total time. Returns
+//  the atomic or function name, or NULL if there are no more.
+const char *
+    zs_vm_profile_next (zs_vm_t *self);
+
+//  Return number of calls for the current profile entry.
+uint64_t
+    zs_vm_profile_calls (zs_vm_t *self);
+
+//  Return total time in nanoseconds for the current profile entry.
+uint64_t
+    zs_vm_profile_nanos (zs_vm_t *self);
+
 //  Atomic API: provides current loop state pipe; for use by loop atomics.
 zs_pipe_t *
     zs_vm_loop_state (zs_vm_t *self);
@@ -177,17 +275,115 @@ zs_pipe_t *
 void
     zs_vm_trace_pipes (zs_vm_t *self, bool trace);
 
+//  Take input from a ring. Each run of the VM first receives one sentence
+//  from the ring, as if its values had been typed before the function. The
+//  VM does not own the ring.
+void
+    zs_vm_set_input (zs_vm_t *self, zs_ring_t *ring);
+
+//  Attach a ring as a named output port, for use by zs_vm_connect. The VM
+//  does not own the ring, but prepares it to carry values; attach it before
+//  any thread sends on it.
+void
+    zs_vm_attach (zs_vm_t *self, const char *name, zs_ring_t *ring);
+
+//  Atomic API: send each sentence's output to the named port, so it becomes
+//  the input of the VM reading that ring. An empty name disconnects. Returns
+//  0 if OK, or -1 if there is no such port. Parallel work has no sentences
+//  to send, and may not walk the shared list of ports, so this fails there.
+int
+    zs_vm_connect (zs_vm_t *self, const char *name);
+
 //  Run last defined function, if any, in the VM. This continues forever or
 //  until the function ends. Returns 0 if stopped successfully, or -1 if
-//  stopped due to some error. Each run of the VM starts with clean pipes.
+//  stopped due to some error, or because the input ring was closed. Each run
+//  of the VM starts with clean pipes.
 int
     zs_vm_run (zs_vm_t *self);
 
+//  Return the address of the last committed function, which zs_vm_run
+//  would call, or 0 if there are no functions. The address stays valid
+//  until the function is rolled back.
+size_t
+    zs_vm_head (zs_vm_t *self);
+
+//  Run the committed function at the given address, as returned by
+//  zs_vm_head, in the same way as zs_vm_run.
+int
+    zs_vm_run_function (zs_vm_t *self, size_t address);
+
+//  Set the number of threads that parallel atomics may use, including the
+//  calling thread. Zero means one per CPU, which is the default.
+void
+    zs_vm_set_workers (zs_vm_t *self, size_t workers);
+
+//  Set the largest function body, in bytes, that the compiler copies into
+//  its callers instead of calling. Inlined functions no longer show up in
+//  profiles or traces. Zero switches inlining off. Applies to code compiled
+//  after this call. Forks inherit the setting.
+void
+    zs_vm_set_inline (zs_vm_t *self, size_t limit);
+
+//  Compile a call at the end of a function as a jump to the called function,
+//  so the call takes no stack. Functions reached that way no longer show up
+//  in profiles or traces. Defaults to true. Applies to code compiled after
+//  this call. Forks inherit the setting.
+void
+    zs_vm_set_tail_calls (zs_vm_t *self, bool tail_calls);
+
+//  Clean up each function's code as we commit it: drop pipe operations that
+//  do nothing, join runs of constants into one instruction, and thread jumps
+//  to jumps. Defaults to true. Applies to
+//  code compiled after this call. Forks inherit the setting.
+void
+    zs_vm_set_peephole (zs_vm_t *self, bool peephole);
+
+//  Work out the types of values as they flow through each function as we
+//  commit it, and call whole number variants of atomics where we can prove
+//  all input values are whole. Defaults to true. Applies to code compiled
+//  after this call. Forks inherit the setting.
+void
+    zs_vm_set_specialize (zs_vm_t *self, bool specialize);
+
+//  Atomic API: apply the named user function to the values on the input
+//  pipe, and send its results to the output pipe. The values are split into
+//  one chunk per worker thread, each worker runs the function on its chunk,
+//  and the results are joined in the original order. The function should
+//  treat each value independently. Worker contexts run any nested pmap on
+//  their own thread. Returns 0 if OK, or -1 if the function is not a user
+//  function or failed.
+int
+    zs_vm_pmap (zs_vm_t *self, const char *name, zs_pipe_t *input, zs_pipe_t *output);
+
 //  Return results as string, after successful execution. Caller must not
 //  modify returned value.
 const char *
     zs_vm_results (zs_vm_t *self);
 
+//  Create a new execution context for the VM's code. Many contexts may run
+//  the same VM at once, each on its own thread, as long as nothing compiles
+//  into the VM or rolls it back meanwhile. Destroy all contexts before the
+//  VM. Returns the reference if successful, or NULL if construction failed
+//  due to lack of available memory.
+zs_exec_t *
+    zs_exec_new (zs_vm_t *vm);
+
+//  Destroy the execution context and free all memory used by it.
+void
+    zs_exec_destroy (zs_exec_t **self_p);
+
+//  Run the committed function at the given address, as returned by
+//  zs_vm_head, in this context. Returns 0 if stopped successfully, or -1
+//  if stopped due to some error, or because the input ring was closed.
+//  Each run starts with clean pipes.
+int
+    zs_exec_run (zs_exec_t *self, size_t address);
+
+//  Return results of the last run as string. Caller must not modify returned
+//  value.
+const char *
+    zs_exec_results (zs_exec_t *self);
+
 //  Self test of this class
 void
     zs_vm_test (bool animate);